@@ -1,1389 +1,4450 @@
 #include "BikeLib.h"
 
-#define RC_RST_PIN      5   // RC522: RST引脚
-#define RC_SS_PIN      53   // RC522: SS引脚（UNO: 10; MEGA: 53）
-#define LOCK_PIN       30   // 开锁用引脚
+#define RC_RST_PIN      5   // RC522: RST引脚（各槽位共用）
+#define BATTERY_PIN    A0   // 电池电压分压采样引脚
+#define RI_PIN          2   // 通讯模块RI引脚（外部中断 INT4 低电平可唤醒掉电休眠）
+
+// 各槽位读卡模块及开锁用引脚（车桩模式下按槽位依次定义 个数须等于STATION_SLOT_COUNT）
+#ifndef STATION_READERS
+#define STATION_READERS     { RFID(53, RC_RST_PIN) }    // RC522: SS引脚（UNO: 10; MEGA: 53）
+#endif
+#ifndef STATION_LOCK_PINS
+#define STATION_LOCK_PINS   { 30 }                      // 开锁用引脚
+#endif
+
+const int LOCK_PINS[] = STATION_LOCK_PINS;
+static_assert(sizeof(LOCK_PINS) / sizeof(LOCK_PINS[0]) == STATION_SLOT_COUNT, "STATION_LOCK_PINS must list one pin per slot");
 
 //////////////////////////////////////
 // --------- 调用工具实例 --------- //
 //////////////////////////////////////
-RFID rfid(RC_SS_PIN, RC_RST_PIN);   // 读卡模块底层操作工具实例
-                                    // 使用SPI通讯
-DFRobot_SIM808 sim808(&Serial);     // 通讯定位模块底层操作工具实例
+RFID READERS[] = STATION_READERS;
+                                    // 读卡模块底层操作工具实例（各槽位）
+                                    // 使用SPI通讯 各槽位SS引脚不同
+static_assert(sizeof(READERS) / sizeof(READERS[0]) == STATION_SLOT_COUNT, "STATION_READERS must list one reader per slot");
+SIM808Modem sim808(&Serial);        // 通讯定位模块底层操作工具实例
 U8GLIB_SH1106_128X64 u8g(U8G_I2C_OPT_NONE);
                                     // 显示模块底层操作工具实例
                                     // 使用TWI通讯
 
 
 //////////////////////////////////////
-// ---------- RentState ----------- //
+// ------------ Timer ------------- //
 //////////////////////////////////////
 /**
- * 车辆借还状态工具构造函数
+ * 定时器工具构造函数
  */
-RentState::RentState(RENT_STATE rentState) {
-    _rentState = rentState;
+Timer::Timer() {
+    _uptimeHigh = 0;
+    _lastTime = 0;
+    _waitHook = NULL;
+
+    for (int i = 0; i < TIMER_COUNT; i++) {
+        _start[i] = 0;
+        _duration[i] = 0;
+        _active[i] = false;
+    }
 }
 
 // public:
 /**
- * 更改全局车辆借还状态
- * @param newState 新的车辆借还状态
+ * 获取运行时间（每次调用时检查系统时间溢出 两次调用间隔不得超过49天）
+ * @return 运行时间（ms）
  */
-void RentState::changeState(const RENT_STATE newState) {
-    _rentState = newState;
+unsigned long long Timer::uptime() {
+    unsigned long now = sysTime();
+    if (now < _lastTime) {
+        // 系统时间溢出
+        _uptimeHigh += 1ULL << 32;
+    }
+    _lastTime = now;
+    return _uptimeHigh | now;
 }
 
 /**
- * 获取全局车辆借还状态
- * @return 车辆借还状态
+ * 开始计时（覆盖同一槽位上的原有计时）
+ * @param id       定时器编号
+ * @param duration 计时时长（ms）
  */
-RENT_STATE RentState::getState() {
-    return _rentState;
+void Timer::start(const TIMER_ID id, const unsigned long duration) {
+    _start[id] = uptime();
+    _duration[id] = duration;
+    _active[id] = true;
 }
 
 /**
- * 检查车辆是否可用
- * @return true - 可用; false - 不可用
+ * 取消计时
+ * @param id 定时器编号
  */
-bool RentState::isAvailable() {
-    if (_rentState == NOT_AVAILABLE) {
-        return false;
-    } else {
-        return true;
-    }
+void Timer::cancel(const TIMER_ID id) {
+    _active[id] = false;
 }
 
-
-//////////////////////////////////////
-// ------------- Card ------------- //
-//////////////////////////////////////
 /**
- * 读卡工具构造函数
+ * 等待至计时结束（未计时时直接返回）
+ * @param id 定时器编号
  */
-Card::Card() {
-    cardSerNum = 0;
-    _cardState = CARD_NOT_FOUND;
-    _cardCounter = 0;
+void Timer::wait(const TIMER_ID id) {
+    hold(remaining(id));
+    _active[id] = false;
 }
 
-// public:
 /**
- * 寻卡并读取卡片信息
- * @return 寻卡结果
+ * 阻塞等待（期间按间隔调用等待钩子）
+ * @param duration 等待时长（ms）
  */
-CARD_MSG Card::searchCard(RENT_STATE state) {
-
-    if ((rfid.isCard()) && (rfid.readCardSerial())) {
-
-        if (state != NOT_AVAILABLE) {
-            // 车辆可用
-            switch (getState()) {
-                case CARD_NOT_FOUND:
-                    addCounter();
-                    changeState(CARD_READING);
-                    return NEW_CARD_DETECTED;
-                break;
-                case CARD_READING:
-                    addCounter();
-                    if (getCounter() > MIN_CARD_READING) {
-                        clearCounter();
-                        changeState(CARD_FOUND);
-                        if (cardSerNum != rfid.cardSerNum()) {
-                            // 发现新卡
-                            cardSerNum = rfid.cardSerNum();
-                            return NEW_CARD_CONFIRMED;
-                        } else {
-                            // 同一张卡
-                            return SAME_CARD_AGAIN;
-                        }
-                    }
-                break;
-                case CARD_FOUND:
-                    // 判断卡片是否改变
-                    if (cardSerNum != rfid.cardSerNum()) {
-                        clearCounter();
-                        changeState(CARD_READING);
-                        cardSerNum = rfid.cardSerNum();
-                        // 返回错误
-                        return ERROR_DIFFERENT_CARD;
-                    }
-                break;
-                case CARD_DETATCHING:
-                    clearCounter();
-                    addCounter();
-                    changeState(CARD_READING);
-                    return NEW_CARD_DETECTED;
-                break;
-                default:
-                break;
-            }
-        } else {
-            // 车辆不可用
-            return ERROR_NOT_AVAILABLE_CARD;
+void Timer::hold(const unsigned long duration) {
+    unsigned long start = millis();
+    unsigned long elapsed = 0;
+    while (elapsed < duration) {
+        if (_waitHook != NULL) {
+            _waitHook();
         }
-    } else {
-        switch (getState()) {
-            case CARD_NOT_FOUND:
-                // 无操作
-            break;
-            case CARD_READING:
-                clearCounter();
-                addCounter();
-                changeState(CARD_DETATCHING);
-                return CARD_DETATCHED;
-            break;
-            case CARD_FOUND:
-                addCounter();
-                changeState(CARD_DETATCHING);
-                return CARD_DETATCHED;
-            break;
-            case CARD_DETATCHING:
-                addCounter();
-                if (getCounter() > MIN_CARD_DETATCH) {
-                    if (cardSerNum != 0) {
-                        // 之前存在卡片
-                        reset();
-                        return CARD_DETATCH_CONFIRMED;
-                    } else {
-                        // 之前无卡片
-                        reset();
-                        return CARD_READ_STOP;
-                    }
-                }
-            break;
-            default:
-            break;
+        elapsed = millis() - start;
+        if (elapsed < duration) {
+            delay(min(duration - elapsed, HOOK_INTERVAL));
+            elapsed = millis() - start;
         }
     }
+}
 
-    return NOTHING;
+/**
+ * 设置等待钩子（钩子内不得阻塞等待）
+ * @param hook 等待钩子（NULL - 无）
+ */
+void Timer::setWaitHook(void (*hook)()) {
+    _waitHook = hook;
 }
 
 /**
- * 获取卡片序列号
- * @return 卡片序列号
+ * 检查是否正在计时（到期后仍视为计时中 直至取消）
+ * @param  id 定时器编号
+ * @return    true - 计时中; false - 未计时
  */
-unsigned long Card::getSerNum() {
-    return cardSerNum;
+bool Timer::isActive(const TIMER_ID id) {
+    return _active[id];
 }
 
 /**
- * 重置读卡工具（改变系统状态 谨慎使用 建议在无卡且未借车状态下使用）
+ * 检查计时是否到期
+ * @param  id 定时器编号
+ * @return    true - 已到期或未计时; false - 计时中
  */
-void Card::reset() {
-    cardSerNum = 0;
-    changeState(CARD_NOT_FOUND);
-    clearCounter();
+bool Timer::expired(const TIMER_ID id) {
+    return remaining(id) == 0;
+}
+
+/**
+ * 获取剩余时间
+ * @param  id 定时器编号
+ * @return    剩余时间（ms 已到期或未计时返回0）
+ */
+unsigned long Timer::remaining(const TIMER_ID id) {
+    if (!_active[id]) {
+        return 0;
+    }
+
+    unsigned long long passed = uptime() - _start[id];
+    if (passed >= _duration[id]) {
+        return 0;
+    }
+    return _duration[id] - (unsigned long) passed;
 }
 
-// private:
 /**
- * 更改读卡状态（内部操作 私有）
- * @param newState 新的读卡状态
+ * 获取计时开始后经过的时间
+ * @param  id 定时器编号
+ * @return    经过时间（ms）
  */
-void Card::changeState(const CARD_STATE newState) {
-    _cardState = newState;
+unsigned long Timer::elapsed(const TIMER_ID id) {
+    return (unsigned long) (uptime() - _start[id]);
 }
 
+
+//////////////////////////////////////
+// ---------- RentState ----------- //
+//////////////////////////////////////
 /**
- * 获取读卡状态（内部操作 私有）
- * @return 读卡状态
+ * 车辆借还状态工具构造函数
  */
-CARD_STATE Card::getState() {
-    return _cardState;
+RentState::RentState(RENT_STATE rentState) {
+    _rentState = rentState;
+    _cardSerial = 0;
+    _requestID = 0;
+    _pending = false;
+    _journalAddr = EEPROM_ADDR_RENT_JOURNAL;
+    _nextSlot = 0;
+    _nextSeq = 0;
+
+    _last.state = (unsigned char) rentState;
+    _last.flags = 0;
+    _last.cardSerial = 0;
+    _last.requestID = 0;
 }
 
+// public:
 /**
- * 获取读卡次数计数器
- * @return 读卡次数计数器
+ * 绑定车桩槽位（各槽位使用独立的日志分区 恢复前调用）
+ * @param slot 槽位编号
  */
-inline int Card::getCounter() {
-    return _cardCounter;
+void RentState::attach(const int slot) {
+    _journalAddr = EEPROM_ADDR_RENT_JOURNAL + slot * JOURNAL_SLOTS * sizeof(Record);
 }
 
 /**
- * 读卡次数计数器加值
+ * 更改全局车辆借还状态（借车结束时清除卡片序列号、借车请求编号及待确认标志）
+ * @param newState 新的车辆借还状态
  */
-inline void Card::addCounter() {
-    _cardCounter++;
+void RentState::changeState(const RENT_STATE newState) {
+    _rentState = newState;
+    if (newState == NOT_RENT || newState == NOT_AVAILABLE) {
+        _cardSerial = 0;
+        _requestID = 0;
+        _pending = false;
+    }
+    journal();
 }
 
 /**
- * 读卡次数计数器清零
+ * 更改全局车辆借还状态并记录借车卡片（与待确认标志、借车请求编号写入同一条日志 开锁前调用）
+ * @param newState   新的车辆借还状态
+ * @param cardSerial 借车卡片序列号
+ * @param pending    借车是否待服务器确认（本地授权或乐观开锁）
+ * @param requestID  借车请求编号（补发时沿用 0 - 无）
  */
-inline void Card::clearCounter() {
-    _cardCounter = 0;
+void RentState::changeState(const RENT_STATE newState, const unsigned long cardSerial, const bool pending, const unsigned long requestID) {
+    _cardSerial = cardSerial;
+    _pending = pending;
+    _requestID = requestID;
+    changeState(newState);
 }
 
+/**
+ * 获取全局车辆借还状态
+ * @return 车辆借还状态
+ */
+RENT_STATE RentState::getState() {
+    return _rentState;
+}
 
-//////////////////////////////////////
-// -------- LocationUpdate -------- //
-//////////////////////////////////////
 /**
- * 定时定位操作工具构造函数
+ * 获取借车卡片序列号
+ * @return 卡片序列号（未借车时为0）
  */
-LocationUpdate::LocationUpdate() {
-    _lastUpdate = sysTime();
-    _updatePaused = false;
+unsigned long RentState::getCardSerial() {
+    return _cardSerial;
+}
 
-    // 默认定位信息
-    _latitude = 1000;
-    _longitude = 1000;
+/**
+ * 获取借车请求编号（待确认借车补发时沿用）
+ * @return 请求编号（0 - 无）
+ */
+unsigned long RentState::getRequestID() {
+    return _requestID;
 }
 
-// public:
 /**
- * 获取上次定位时间
- * @return 上次定位时间
+ * 设置借车是否待服务器确认（本地授权或乐观开锁）
+ * @param pending true - 待确认; false - 已确认
  */
-unsigned long LocationUpdate::getLastUpdate() {
-    return _lastUpdate;
+void RentState::setPending(const bool pending) {
+    if (_pending != pending) {
+        _pending = pending;
+        journal();
+    }
 }
 
+/**
+ * 检查借车是否待服务器确认
+ * @return true - 待确认; false - 已确认
+ */
+bool RentState::isPending() {
+    return _pending;
+}
 
 /**
- * 检查是否需要进行定位（依现在借车状态而定）
- * @return true - 需要; false - 不需要
+ * 从EEPROM日志恢复状态（启动时调用 取校验有效且序号最新的记录）
+ * 借车中恢复为未借车 还车中恢复为已借车（重新检测卡片取走后还车）
+ * @return true - 已恢复; false - 无有效记录
  */
-bool LocationUpdate::needUpdate(const RENT_STATE state) {
+bool RentState::restore() {
+    Record latest;
+    int latestSlot = -1;
 
-    // 检查更新是否被暂停
-    if (_updatePaused) {
+    for (int i = 0; i < JOURNAL_SLOTS; i++) {
+        Record record;
+        EEPROM.get(_journalAddr + i * sizeof(Record), record);
+        if (record.check != checksum(record)) {
+            continue;
+        }
+        // 序号比较考虑溢出
+        if (latestSlot < 0 || (int) (record.seq - latest.seq) > 0) {
+            latest = record;
+            latestSlot = i;
+        }
+    }
+
+    if (latestSlot < 0) {
         return false;
     }
 
-    // 检查车辆状态
-    switch (state) {
-        case RENT:
-            if (!withinInterval(_lastUpdate, sysTime(), UPDATE_INTERVAL_RENT)) {
-                // 与上次更新相差时间足够
-                return true;
-            }
-        break;
-        case NOT_RENT:
-            if (!withinInterval(_lastUpdate, sysTime(), UPDATE_INTERVAL_NOT_RENT)) {
-                // 与上次更新相差时间足够
-                return true;
-            }
-        break;
-        case NOT_AVAILABLE:
-            if (!withinInterval(_lastUpdate, sysTime(), UPDATE_INTERVAL_NOT_AVAILABLE)) {
-                // 与上次更新相差时间足够
-                return true;
-            }
-        break;
-        default:
-        break;
+    _nextSlot = (latestSlot + 1) % JOURNAL_SLOTS;
+    _nextSeq = latest.seq + 1;
+    _last = latest;
+
+    _rentState = (RENT_STATE) latest.state;
+    _cardSerial = latest.cardSerial;
+    _requestID = latest.requestID;
+    _pending = (latest.flags & FLAG_PENDING) != 0;
+
+    if (_rentState == RENT_UNDER_WAY) {
+        _rentState = NOT_RENT;
+        _cardSerial = 0;
+        _requestID = 0;
+        _pending = false;
+    } else if (_rentState == RETURN_UNDER_WAY) {
+        _rentState = RENT;
     }
 
-    return false;
+    Log(TAG_JOURNAL, "Restored: " + String((int) _rentState) + ", " + String(_cardSerial));
+    return true;
 }
 
 /**
- * 暂停定位和检查电量操作
+ * 检查车辆是否可用
+ * @return true - 可用; false - 不可用
  */
-void LocationUpdate::pauseUpdate() {
-    Log(TAG_LOCATION, "Location Update Paused");
-    _updatePaused = true;
+bool RentState::isAvailable() {
+    if (_rentState == NOT_AVAILABLE) {
+        return false;
+    } else {
+        return true;
+    }
 }
 
+
+// private:
 /**
- * 恢复定位和检查电量操作
+ * 写入日志（内部操作 私有）
+ * 内容改变时写入下一槽位 校验字节保证断电时写入一半的记录不被采用
  */
-void LocationUpdate::resumeUpdate() {
-    Log(TAG_LOCATION, "Location Update Resumed");
-    _updatePaused = false;
+void RentState::journal() {
+    Record record;
+    record.state = (unsigned char) _rentState;
+    record.flags = _pending ? FLAG_PENDING : 0;
+    record.cardSerial = _cardSerial;
+    record.requestID = _requestID;
+
+    // 内容未变（如低电量时每循环置为不可用）
+    if (record.state == _last.state && record.flags == _last.flags && record.cardSerial == _last.cardSerial && record.requestID == _last.requestID) {
+        return;
+    }
+
+    record.seq = _nextSeq;
+    record.check = checksum(record);
+
+    EEPROM.put(_journalAddr + _nextSlot * sizeof(Record), record);
+    _last = record;
+
+    _nextSlot = (_nextSlot + 1) % JOURNAL_SLOTS;
+    _nextSeq++;
 }
 
 /**
- * 定位和检查电量操作 成功后更新时间
- * @return 预留
+ * 计算记录校验（内部操作 私有）
+ * @param  record 日志记录
+ * @return        校验字节
  */
-bool LocationUpdate::doUpdate() {
-    
-    // 重置定位信息
-    resetLocation();
+unsigned char RentState::checksum(const Record &record) {
+    const unsigned char* bytes = (const unsigned char*) &record;
+    unsigned char check = 0xA5;
+    for (unsigned int i = 0; i < sizeof(Record) - 1; i++) {
+        check = (check << 1 | check >> 7) ^ bytes[i];
+    }
+    return check;
+}
 
-    bool locateSuccess = false;
 
-    // 打开GPS
-    locateSuccess = sim808.attachGPS();
-    if (locateSuccess) {
-        // 获取初始时间
-        unsigned long startGPS = sysTime();
-        locateSuccess = false;
+//////////////////////////////////////
+// ------------- Card ------------- //
+//////////////////////////////////////
+/**
+ * 读卡工具构造函数
+ */
+template <class READER>
+CardT<READER>::CardT() {
+    _reader = NULL;
+    _lastActivity = 0;
+    _readerDown = false;
+}
 
-        // 如果定位未超时
-        while(withinInterval(startGPS, sysTime(), GPS_OVERTIME)) {
-            // 是否接收到GPS数据
-            if (sim808.getGPS()) {
-                _latitude = sim808.GPSdata.lat;
-                _longitude = sim808.GPSdata.lon;
-                locateSuccess = true;
-                break;
-            }
+// public:
+/**
+ * 绑定读卡模块（车桩模式下各槽位不同）
+ * @param reader 读卡模块底层操作工具实例
+ */
+template <class READER>
+void CardT<READER>::attach(READER* reader) {
+    _reader = reader;
+}
+
+/**
+ * 寻卡并读取卡片信息（状态转移见 CARD_TRANSITIONS）
+ * @return 寻卡结果
+ */
+template <class READER>
+CARD_MSG CardT<READER>::searchCard(RENT_STATE state) {
+
+    // 唤醒读卡模块
+    wakeReader();
+
+    // 防抖阈值随运行参数即时生效
+    _debounce.setThresholds(CONFIG.get(CONFIG_CARD_MIN_READING), CONFIG.get(CONFIG_CARD_MIN_DETATCH));
+
+    CARD_MSG msg;
+    if ((_reader->isCard()) && (_reader->readCardSerial())) {
+
+        if (state == NOT_AVAILABLE) {
+            // 车辆不可用
+            msg = ERROR_NOT_AVAILABLE_CARD;
+        } else {
+            // 车辆可用
+            msg = _debounce.step(true, _reader->cardSerNum());
         }
-        Log(TAG_LOCATION, "GPS Overtime!");
-    }
-    else {
-        Log(TAG_LOCATION, "GPS Init Fail!");
+    } else {
+        msg = _debounce.step(false, 0);
     }
 
-    // 关闭GPS
-    sim808.detachGPS();
-    // 更新时间
-    _lastUpdate = sysTime();
+    // 记录读卡活动
+    if (msg != NOTHING || _debounce.isActive()) {
+        _lastActivity = sysTime();
+    }
 
-    return locateSuccess;
+    return msg;
 }
 
 /**
- * 重置定位信息（定位前重置）
+ * 获取卡片序列号
+ * @return 卡片序列号
  */
-void LocationUpdate::resetLocation() {
-    _lastUpdate = sysTime();
-    _updatePaused = false;
-
-    // 重置定位信息
-    _latitude = 1000;
-    _longitude = 1000;
+template <class READER>
+unsigned long CardT<READER>::getSerNum() {
+    return _debounce.getSerNum();
 }
 
 /**
- * 重置工具（全部重置 谨慎使用）
+ * 获取下次寻卡前等待时间（读卡中快速寻卡 长时间空闲时降低频率）
+ * @return 寻卡间隔（ms）
  */
-void LocationUpdate::reset() {
+template <class READER>
+unsigned long CardT<READER>::getPollInterval() {
+    if (_debounce.isActive()) {
+        return POLL_INTERVAL_ACTIVE;
+    }
+    if (withinInterval(_lastActivity, sysTime(), DORMANT_AFTER)) {
+        return POLL_INTERVAL_IDLE;
+    }
+    return POLL_INTERVAL_DORMANT;
+}
 
-    // 重置定位信息
-    _latitude = 1000;
-    _longitude = 1000;
+/**
+ * 两次寻卡之间 空闲时读卡模块进入软件掉电（寄存器内容保持）
+ */
+template <class READER>
+void CardT<READER>::standby() {
+    if (!_debounce.isActive() && !_readerDown) {
+        _reader->writeMFRC522(RC_COMMAND_REG, RC_CMD_IDLE | RC_POWER_DOWN);
+        _readerDown = true;
+    }
 }
 
 /**
- * 获取纬度信息
- * @return 纬度
+ * 恢复为已发现卡片（重启后恢复借车状态时使用 卡片取走后正常还车）
+ * @param cardSerial 借车卡片序列号
  */
-float LocationUpdate::getLatitude() {
-    return _latitude;
+template <class READER>
+void CardT<READER>::restore(const unsigned long cardSerial) {
+    _debounce.restore(cardSerial);
 }
 
 /**
- * 获取经度信息
- * @return 经度
+ * 重置读卡工具（改变系统状态 谨慎使用 建议在无卡且未借车状态下使用）
  */
-float LocationUpdate::getLongitude() {
-    return _longitude;
+template <class READER>
+void CardT<READER>::reset() {
+    _debounce.reset();
 }
 
 // private:
+/**
+ * 退出软件掉电 等待振荡器恢复（内部操作 私有）
+ */
+template <class READER>
+void CardT<READER>::wakeReader() {
+    if (!_readerDown) {
+        return;
+    }
 
+    _reader->writeMFRC522(RC_COMMAND_REG, RC_CMD_IDLE);
+    for (int i = 0; i < RC_WAKE_RETRY; i++) {
+        if ((_reader->readMFRC522(RC_COMMAND_REG) & RC_POWER_DOWN) == 0) {
+            break;
+        }
+        delay(1);
+    }
+    _readerDown = false;
+}
 
 
 //////////////////////////////////////
-// ----------- HttpCom ------------ //
+// ---------- CardCache ----------- //
 //////////////////////////////////////
 /**
- * 通讯工具构造函数
+ * 本地授权卡片缓存工具构造函数
  */
-HTTPCom::HTTPCom() {
-    _hasResponse = false;
-    _userID = "";
-    _balance = "";
-    _duration = "";
-    _request = "";
-    _state = RESPONSE_NULL;
+CardCache::CardCache() {
 }
 
 // public:
 /**
- * 发送借车请求
- * @param  bikeID     自行车编号
+ * 查询卡片是否已授权（二分查找）
  * @param  cardSerial 卡片序列号
- * @return            请求是否成功（仅包括通讯及解码层）
- *                    true - 成功; false - 失败
+ * @return            true - 已授权; false - 未授权
  */
-bool HTTPCom::requestRent(const int bikeID, const unsigned long cardSerial) {
-    // request清空
-    _request = "";
-    // 指令开始
-    _request = String(REQUEST_CMD_HEADER);
-    // 借车还车请求
-    _request += REQUEST_CMD_RENT_RETURN;
-    // 请求码
-    _request += (String(KEY_STATE) + "=");
-    _request += (String(REQUEST_RENT) + ",");
-    // 车辆编号
-    _request += (String(KEY_BIKEID) + "=");
-    _request += (String(bikeID) + ",");
-    // 卡片序列号
-    _request += (String(KEY_CARDSERIAL) + "=");
-    _request += String(cardSerial);
-    // 指令截止符
-    _request += REQUEST_CMD_ENDER;
+bool CardCache::contains(const unsigned long cardSerial) {
+    int low = 0;
+    int high = (int) getCount() - 1;
 
-    // 发送请求
-    return sendRequest();
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        unsigned long card = readCard(mid);
+        if (card == cardSerial) {
+            return true;
+        } else if (card < cardSerial) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return false;
 }
 
 /**
- * 发送还车请求
- * @param  bikeID     自行车编号
- * @param  cardSerial 卡片序列号
- * @return            请求是否成功（仅包括通讯及解码层）
- *                    true - 成功; false - 失败
+ * 保存服务器下发的授权卡片
+ * 先校验全部序列号（格式错误时缓存及版本号均保持不变 服务器随后重新下发）
+ * 再清空卡片数及版本号 写入序列号后写入版本号及卡片数 中途断电时缓存为空而非错误（版本号为0 服务器随后重新下发）
+ * @param  version 缓存版本号
+ * @param  cards   卡片序列号（每张8位十六进制 按升序连续排列）
+ * @return         true - 保存成功; false - 格式错误或超出容量
  */
-bool HTTPCom::requestReturn(const int bikeID, const unsigned long cardSerial) {
-    // request清空
-    _request = "";
-    // 指令开始
-    _request = String(REQUEST_CMD_HEADER);
-    // 借车还车请求
-    _request += REQUEST_CMD_RENT_RETURN;
-    // 请求码
-    _request += (String(KEY_STATE) + "=");
-    _request += (String(REQUEST_RETURN) + ",");
-    // 车辆编号
-    _request += (String(KEY_BIKEID) + "=");
-    _request += (String(bikeID) + ",");
-    // 卡片序列号
-    _request += (String(KEY_CARDSERIAL) + "=");
-    _request += String(cardSerial);
-    // 指令截止符
-    _request += REQUEST_CMD_ENDER;
+bool CardCache::store(const unsigned int version, const char* cards) {
+    int length = strlen(cards);
+    if (length % SERIAL_HEX_LENGTH != 0 || length / SERIAL_HEX_LENGTH > CAPACITY) {
+        return false;
+    }
+    unsigned char count = length / SERIAL_HEX_LENGTH;
 
-    // 发送请求
-    return sendRequest();
+    unsigned long card;
+    unsigned long last = 0;
+    for (unsigned char i = 0; i < count; i++) {
+        if (!parseCard(cards + i * SERIAL_HEX_LENGTH, card)) {
+            return false;
+        }
+
+        // 必须严格升序（二分查找）
+        if (i > 0 && card <= last) {
+            return false;
+        }
+        last = card;
+    }
+
+    // 清空卡片数及版本号
+    EEPROM.put(ADDR_COUNT, (unsigned char) 0);
+    EEPROM.put(ADDR_VERSION, (unsigned int) 0);
+
+    for (unsigned char i = 0; i < count; i++) {
+        parseCard(cards + i * SERIAL_HEX_LENGTH, card);
+        EEPROM.put(ADDR_CARDS + i * sizeof(unsigned long), card);
+    }
+
+    EEPROM.put(ADDR_VERSION, version);
+    EEPROM.put(ADDR_COUNT, count);
+
+    Log(TAG_CACHE, "Cache Updated: " + String(version));
+    return true;
 }
 
 /**
- * 发送定位信息
- * @param  bikeID       自行车编号
- * @param  longitude    经度
- * @param  latitude     纬度
- * @param  batteryLevel 电量信息
- * @return              请求是否成功（仅包括通讯及解码层）
- *                      true - 成功; false - 失败
+ * 获取缓存版本号（随定位信息发送 服务器据此判断是否下发）
+ * @return 缓存版本号
  */
-bool HTTPCom::requestLocation(const int bikeID, const float longitude, const float latitude, const float batteryLevel) {
-    // request清空
-    _request = "";
-    // 指令开始
-    _request = String(REQUEST_CMD_HEADER);
-    // 定位成功请求
-    _request += REQUEST_CMD_LOCATION;
-    // 请求码
-    _request += (String(KEY_STATE) + "=");
-    _request += (String(REQUEST_LOCATION) + ",");
-    // 车辆编号
-    _request += (String(KEY_BIKEID) + "=");
-    _request += (String(bikeID) + ",");
-    // 定位经度
-    _request += (String(KEY_LONGITUDE) + "=");
-    _request += (String(longitude) + ",");
-    // 定位纬度
-    _request += (String(KEY_LATITUDE) + "=");
-    _request += (String(latitude) + ",");
-    // 电池电量
-    _request += (String(KEY_BATTERYLEVEL) + "=");
-    _request += String(batteryLevel);
-    // 指令截止符
-    _request += REQUEST_CMD_ENDER;
-
-    // 发送请求
-    return sendRequest();
+unsigned int CardCache::getVersion() {
+    unsigned int version;
+    EEPROM.get(ADDR_VERSION, version);
+    // 未写入过的EEPROM
+    if (version == 0xFFFF) {
+        return 0;
+    }
+    return version;
 }
 
 /**
- * 发送定位失败信息
- * @param  bikeID       自行车编号
- * @param  batteryLevel 电量信息
- * @return              请求是否成功（仅包括通讯及解码层）
- *                      true - 成功; false - 失败
+ * 获取缓存卡片数
+ * @return 缓存卡片数
  */
-bool HTTPCom::requestLocationFail(const int bikeID, const float batteryLevel) {
-    // request清空
-    _request = "";
-    // 指令开始
-    _request = String(REQUEST_CMD_HEADER);
-    // 定位失败或低电量请求
-    _request += REQUEST_CMD_BATTERY;
-    // 请求码
-    _request += (String(KEY_STATE) + "=");
-    _request += (String(REQUEST_LOCATION_FAIL) + ",");
-    // 车辆编号
-    _request += (String(KEY_BIKEID) + "=");
-    _request += (String(bikeID) + ",");
-    // 电池电量
-    _request += (String(KEY_BATTERYLEVEL) + "=");
-    _request += String(batteryLevel);
-    // 指令截止符
-    _request += REQUEST_CMD_ENDER;
-
-    // 发送请求
-    return sendRequest();
+unsigned char CardCache::getCount() {
+    unsigned char count;
+    EEPROM.get(ADDR_COUNT, count);
+    // 未写入过的EEPROM
+    if (count > CAPACITY) {
+        return 0;
+    }
+    return count;
 }
 
+// private:
 /**
- * 发送低电量信息
- * @param  bikeID       自行车编号
- * @param  batteryLevel 电量信息
- * @return              请求是否成功（仅包括通讯及解码层）
- *                      true - 成功; false - 失败
+ * 读取缓存卡片序列号（内部操作 私有）
+ * @param  index 序号
+ * @return       卡片序列号
  */
-bool HTTPCom::requestLowBattery(const int bikeID, const float batteryLevel) {
-    // request清空
-    _request = "";
-    // 指令开始
-    _request = String(REQUEST_CMD_HEADER);
-    // 定位失败或低电量请求
-    _request += REQUEST_CMD_BATTERY;
-    // 请求码
-    _request += (String(KEY_STATE) + "=");
-    _request += (String(REQUEST_LOWBATTERY) + ",");
-    // 车辆编号
-    _request += (String(KEY_BIKEID) + "=");
-    _request += (String(bikeID) + ",");
-    // 电池电量
-    _request += (String(KEY_BATTERYLEVEL) + "=");
-    _request += String(batteryLevel);
-    // 指令截止符
-    _request += REQUEST_CMD_ENDER;
-
-    // 发送请求
-    return sendRequest();
+unsigned long CardCache::readCard(const unsigned char index) {
+    unsigned long card;
+    EEPROM.get(ADDR_CARDS + index * sizeof(unsigned long), card);
+    return card;
 }
 
 /**
- * 检查是否有回复信息（获取回复信息前使用）
- * @return true - 有; false - 没有
+ * 解析十六进制卡片序列号（内部操作 私有）
+ * @param  hex  序列号（SERIAL_HEX_LENGTH 位十六进制）
+ * @param  card 解析结果
+ * @return      true - 成功; false - 含非十六进制字符
  */
-bool HTTPCom::hasResponse() {
-    return _hasResponse;
+bool CardCache::parseCard(const char* hex, unsigned long &card) {
+    card = 0;
+    for (int j = 0; j < SERIAL_HEX_LENGTH; j++) {
+        char c = hex[j];
+        card <<= 4;
+        if (c >= '0' && c <= '9') {
+            card |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            card |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            card |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    return true;
 }
 
+
+//////////////////////////////////////
+// --------- CardHistory ---------- //
+//////////////////////////////////////
 /**
- * 获取回复信息编码
- * （获取前请检查是否有回复 hasResponse）
- * @return state 回复信息编码
+ * 卡片借车记录工具构造函数
  */
-RESPONSE_MSG HTTPCom::getResponse() {
-    if (_hasResponse) {
-        return _state;
-    } else {
-        return RESPONSE_NULL;
+CardHistory::CardHistory() {
+    for (int i = 0; i < CAPACITY; i++) {
+        _cards[i] = 0;
+        _successes[i] = 0;
     }
+    _next = 0;
 }
 
+// public:
 /**
- * 获取错误信息编码
- * （存在通讯及解码层错误 无法获得信息层信息）
- * @return state 回复信息编码
+ * 检查卡片是否可乐观开锁
+ * @param  cardSerial 卡片序列号
+ * @return            true - 近期连续借车成功; false - 无记录或曾被拒绝
  */
-RESPONSE_MSG HTTPCom::getError() {
-    if (_state >= ERROR_STATUS) {
-        _hasResponse = false;
-        return _state;
-    } else {
-        return RESPONSE_NULL;
+bool CardHistory::isTrusted(const unsigned long cardSerial) {
+    int index = find(cardSerial);
+    if (index < 0) {
+        return false;
     }
+    return _successes[index] >= TRUST_THRESHOLD;
 }
 
 /**
- * 获取回复内容：userID 学生证号
- * （获取前请检查是否有回复 hasResponse）
- * @return userID 学生证号
+ * 记录借车成功（无记录时替换最早加入的记录）
+ * @param cardSerial 卡片序列号
  */
-String HTTPCom::getResponse_UserID() {
-    if (_hasResponse) {
-        return _userID;
-    } else {
-        return "";
+void CardHistory::recordSuccess(const unsigned long cardSerial) {
+    int index = find(cardSerial);
+    if (index < 0) {
+        index = _next;
+        _next = (_next + 1) % CAPACITY;
+        _cards[index] = cardSerial;
+        _successes[index] = 0;
+    }
+
+    if (_successes[index] < 0xFF) {
+        _successes[index]++;
     }
 }
 
 /**
- * 获取回复内容：balance 余额
- * （获取前请检查是否有回复 hasResponse）
- * @return balance 余额
+ * 记录借车被拒绝（清空连续成功次数）
+ * @param cardSerial 卡片序列号
  */
-String HTTPCom::getResponse_Balance() {
-    if (_hasResponse) {
-        return _balance;
-    } else {
-        return "";
+void CardHistory::recordFail(const unsigned long cardSerial) {
+    int index = find(cardSerial);
+    if (index >= 0) {
+        _successes[index] = 0;
     }
 }
 
+// private:
 /**
- * 获取回复内容：duration 用车时长
- * （获取前请检查是否有回复 hasResponse）
- * @return duration 用车时长
+ * 查找卡片记录（内部操作 私有）
+ * @param  cardSerial 卡片序列号
+ * @return            记录序号（无记录时返回-1）
  */
-String HTTPCom::getResponse_Duration() {
-    if (_hasResponse) {
-        return _duration;
-    } else {
-        return "";
+int CardHistory::find(const unsigned long cardSerial) {
+    if (cardSerial == 0) {
+        return -1;
+    }
+    for (int i = 0; i < CAPACITY; i++) {
+        if (_cards[i] == cardSerial) {
+            return i;
+        }
     }
+    return -1;
 }
 
+
+//////////////////////////////////////
+// -------- LocationUpdate -------- //
+//////////////////////////////////////
 /**
- * 重置回复 清空回复信息（完成回复信息处理后务必调用）
+ * 定时定位操作工具构造函数
  */
-void HTTPCom::resetResponse() {
-    _hasResponse = false;
-    _userID = "";
-    _balance = "";
-    _duration = "";
-    _state = RESPONSE_NULL;
-    sim808.reset_HTTP_HTTPTERM();
-    sim808.reset_HTTP_SAPBR_0_1();
+template <class MODEM, MODEM &modem>
+LocationUpdateT<MODEM, modem>::LocationUpdateT() {
+    _updatePaused = false;
+    _updateRequested = false;
+
+    // 默认定位信息
+    _latitude = 1000;
+    _longitude = 1000;
 }
 
-// private:
+// public:
 /**
- * 使用通讯模块向服务器发送请求
- * @param  request 通讯模块请求指令（包括AT指令与请求内容）
- * @return         请求是否成功（仅包括通讯及解码层）
- *                 true - 成功; false - 失败
+ * 获取上次定位时间
+ * @return 上次定位时间
  */
-bool HTTPCom::sendRequest() {
-    resetResponse();
-    bool requestSuccess = true;
+template <class MODEM, MODEM &modem>
+unsigned long LocationUpdateT<MODEM, modem>::getLastUpdate() {
+    return sysTime() - TIMER.elapsed(TIMER_LOCATION);
+}
 
-    // 联网相关
-    requestSuccess = sim808.HTTP_SAPBR_3_1();
-    delay(INTERVAL_SHORT);
-    if (!requestSuccess) {
-        Error("SAPBR_3_1 FAIL!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_REQUEST_OVERTIME;
-        return requestSuccess;
-    }
 
-    // 打开承载
-    requestSuccess = sim808.HTTP_SAPBR_1_1();
-    if (requestSuccess) {
-        // 长时间停顿
-        delay(INTERVAL_LONG);
-    } else {
-        delay(INTERVAL_SHORT);
-        Error("SAPBR_1_1 FAIL!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_REQUEST_OVERTIME;
-        return requestSuccess;
+/**
+ * 检查是否需要进行定位（依现在借车状态而定）
+ * @return true - 需要; false - 不需要
+ */
+template <class MODEM, MODEM &modem>
+bool LocationUpdateT<MODEM, modem>::needUpdate(const RENT_STATE state) {
+
+    // 检查更新是否被暂停
+    if (_updatePaused) {
+        return false;
     }
 
-    // 初始化HTTP功能
-    requestSuccess = sim808.HTTP_HTTPINIT();
-    delay(INTERVAL_SHORT);
-    if (!requestSuccess) {
-        Error("HTTPINIT FAIL!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_REQUEST_OVERTIME;
-        return requestSuccess;
+    // 服务器要求立即定位
+    if (_updateRequested) {
+        return true;
     }
 
-    requestSuccess = sim808.HTTP_HTTPPARA_CID();
-    delay(INTERVAL_SHORT);
-    if (!requestSuccess) {
-        Error("HTTPPARA_CID FAIL!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_REQUEST_OVERTIME;
-        return requestSuccess;
+    // 检查车辆状态
+    unsigned long interval = getInterval(state);
+    if (interval == 0) {
+        return false;
     }
 
-    // 连接到指定URL
-    requestSuccess = sim808.HTTP_HTTPPARA_URL(_request);
-    delay(INTERVAL_SHORT);
-    if (!requestSuccess) {
-        Error("HTTPPARA_URL FAIL!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_REQUEST_OVERTIME;
-        return requestSuccess;
+    // 与上次更新相差时间足够
+    return TIMER.elapsed(TIMER_LOCATION) >= interval;
+}
+
+/**
+ * 获取距下次定位的时间（依现在借车状态而定）
+ * @return 距下次定位时间（ms 暂停中或借还车操作中返回0）
+ */
+template <class MODEM, MODEM &modem>
+unsigned long LocationUpdateT<MODEM, modem>::getTimeToUpdate(const RENT_STATE state) {
+
+    // 暂停中说明正在读卡 随时可能借还车
+    if (_updatePaused) {
+        return 0;
     }
-    /*Log("Send request!");*/
 
-    // 发送请求
-    requestSuccess = sim808.HTTP_HTTPACTION();
-    delay(INTERVAL_SHORT);
-    if (!requestSuccess) {
-        Error("HTTPACTION FAIL!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_REQUEST_OVERTIME;
-        return requestSuccess;
+    if (_updateRequested) {
+        return 0;
     }
 
-    // 读取服务器返回信息
-    String msg = sim808.HTTP_HTTPREAD();
-    delay(INTERVAL_SHORT);
-    if (msg == "") {
-        requestSuccess = false;
-        Log("Empty response!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_INVALID_RESPONSE;
-        return requestSuccess;
+    unsigned long interval = getInterval(state);
+    if (interval == 0) {
+        return 0;
     }
 
-    // 回复信息解码
-    requestSuccess = decodeResponse(msg);
-    if (requestSuccess) {
-        Log("decodeResponse SUCCESS!");
-        // 关闭HTTP功能
-        requestSuccess = requestSuccess && sim808.HTTP_HTTPTERM();
-        if (requestSuccess) delay(INTERVAL_SHORT);
-        // 关闭承载
-        requestSuccess = requestSuccess && sim808.HTTP_SAPBR_0_1();
-        if (requestSuccess) delay(INTERVAL_SHORT);
-    } else {
-        requestSuccess = false;
-        Log("decodeResponse FAIL!");
-        sim808.HTTP_HTTPTERM();
-        delay(INTERVAL_SHORT);
-        sim808.HTTP_SAPBR_0_1();
-        delay(INTERVAL_SHORT);
-        _state = ERROR_DECODE;
+    unsigned long elapsed = TIMER.elapsed(TIMER_LOCATION);
+    if (elapsed >= interval) {
+        return 0;
     }
+    return interval - elapsed;
+}
 
-    return requestSuccess;
+/**
+ * 要求下次循环立即定位（不受定位间隔限制 暂停中则恢复后定位）
+ */
+template <class MODEM, MODEM &modem>
+void LocationUpdateT<MODEM, modem>::requestUpdate() {
+    Log(TAG_LOCATION, "Location Update Requested");
+    _updateRequested = true;
 }
 
 /**
- * 按照JSON格式解码回复信息
- * @param  response 回复信息
- * @return          true - 解码成功; false - 解码失败
+ * 暂停定位和检查电量操作
  */
-bool HTTPCom::decodeResponse(String response) {
+template <class MODEM, MODEM &modem>
+void LocationUpdateT<MODEM, modem>::pauseUpdate() {
+    Log(TAG_LOCATION, "Location Update Paused");
+    _updatePaused = true;
+}
 
-    int start = response.indexOf("{");
-    int end = response.lastIndexOf("}");
-    response = response.substring(start, end + 1);
-    const char *responseStr = response.c_str();
-    aJsonObject *msg = aJson.parse(responseStr);
-    aJsonObject *Jstate = aJson.getObjectItem(msg, KEY_STATE);
-    int state = (Jstate->valueint);
-    bool decodeSuccess = true;
-    if ((state == RENT_SUCCESS) || (state == RETURN_SUCCESS)) {
-        aJsonObject *JuserID = aJson.getObjectItem(msg, KEY_USERID);
-        aJsonObject *Jbalance = aJson.getObjectItem(msg, KEY_BALANCE);
-        aJsonObject *Jduration = aJson.getObjectItem(msg, KEY_DURATION);
-        _state = (RESPONSE_MSG) state;
-        _userID = (JuserID->valuestring);
-        _balance = (Jbalance->valuestring);
-        _duration = (Jduration->valuestring);
-    } else {
-        switch(state) {
-            case RENT_FAIL_USER_OCCUPIED:
-            case RENT_FAIL_USER_NONEXISTENT:
-            case RENT_FAIL_NEGATIVE_BALANCE:
-            case RENT_FAIL_BIKE_OCCUPIED:
-            case RENT_FAIL_BIKE_UNAVAILABLE:
-            case RETURN_FAIL_USER_NOT_MATCH:
-            case RETURN_FAIL_ORDER_NONEXISTENT:
-            case LOCATION_SUCCESS:
-            case LOCATION_SUCCESS_NOT_AVAILABLE:
-            case LOCATION_FAIL:
-            case LOWBATTERY_SUCCESS:
-            case LOWBATTERY_FAIL:
-            case ERROR_OTHER:
-                _state = (RESPONSE_MSG) state;
-            break;
-            default:
-                decodeSuccess = false;
-            break;
+/**
+ * 恢复定位和检查电量操作
+ */
+template <class MODEM, MODEM &modem>
+void LocationUpdateT<MODEM, modem>::resumeUpdate() {
+    Log(TAG_LOCATION, "Location Update Resumed");
+    _updatePaused = false;
+}
+
+/**
+ * 定位和检查电量操作 成功后更新时间
+ * @return 预留
+ */
+template <class MODEM, MODEM &modem>
+bool LocationUpdateT<MODEM, modem>::doUpdate() {
+    
+    // 重置定位信息
+    resetLocation();
+
+    // 唤醒通讯模块
+    POWER.wakeModem();
+
+    bool locateSuccess = false;
+
+    // 打开GPS
+    unsigned long stageStart = sysTime();
+    unsigned long profileStart = micros();
+    locateSuccess = modem.attachGPS();
+    PROFILER.record(STAGE_GPS_ATTACH, profileStart);
+    Trace(STAGE_GPS_ATTACH, stageStart, locateSuccess);
+    if (locateSuccess) {
+        // 获取初始时间
+        unsigned long startGPS = sysTime();
+        profileStart = micros();
+        locateSuccess = false;
+
+        // 如果定位未超时
+        while(withinInterval(startGPS, sysTime(), CONFIG.get(CONFIG_GPS_OVERTIME))) {
+            // 是否接收到GPS数据
+            if (modem.getGPS()) {
+                _latitude = modem.GPSdata.lat;
+                _longitude = modem.GPSdata.lon;
+                locateSuccess = true;
+                break;
+            }
         }
+        PROFILER.record(STAGE_GPS_READ, profileStart);
+        Trace(STAGE_GPS_READ, startGPS, locateSuccess, String(_latitude) + "," + String(_longitude));
+        Log(TAG_LOCATION, "GPS Overtime!");
     }
-    aJson.deleteItem(msg);
-
-    if (decodeSuccess) {
-        _hasResponse = true;
+    else {
+        Log(TAG_LOCATION, "GPS Init Fail!");
     }
 
-    return decodeSuccess;
-}
+    // 关闭GPS
+    stageStart = sysTime();
+    profileStart = micros();
+    bool detachSuccess = modem.detachGPS();
+    PROFILER.record(STAGE_GPS_DETACH, profileStart);
+    Trace(STAGE_GPS_DETACH, stageStart, detachSuccess);
+    // 更新时间
+    TIMER.start(TIMER_LOCATION, 0);
+    _updateRequested = false;
 
+    return locateSuccess;
+}
 
-//////////////////////////////////////
-// ----------- Display ------------ //
-//////////////////////////////////////
 /**
- * 显示工具构造函数
+ * 重置定位信息（定位前重置）
  */
-Display::Display() {
-    if (u8g.getMode() == U8G_MODE_R3G3B2) {
-        // 八位色模式下使用白色
-        u8g.setColorIndex(255);
-    } else if (u8g.getMode() == U8G_MODE_GRAY2BIT) {
-        // 二位灰度模式下使用最大灰度（白色）
-        u8g.setColorIndex(3);
-    } else if (u8g.getMode() == U8G_MODE_BW) {
-        // 一位黑白模式下使用白色
-        u8g.setColorIndex(1);        
-    } else if (u8g.getMode() == U8G_MODE_HICOLOR) {
-        // 16位色模式下使用白色
-        u8g.setHiColorByRGB(255,255,255);
-    }
+template <class MODEM, MODEM &modem>
+void LocationUpdateT<MODEM, modem>::resetLocation() {
+    TIMER.start(TIMER_LOCATION, 0);
+    _updatePaused = false;
 
-    _isDisplaying = false;
+    // 重置定位信息
+    _latitude = 1000;
+    _longitude = 1000;
 }
 
-// public:
 /**
- * 检查显示屏是否正在显示信息
- * @return true - 正在显示; false - 无显示
+ * 重置工具（全部重置 谨慎使用）
  */
-bool Display::isDisplaying() {
-    return _isDisplaying;
+template <class MODEM, MODEM &modem>
+void LocationUpdateT<MODEM, modem>::reset() {
+
+    // 重置定位信息
+    _latitude = 1000;
+    _longitude = 1000;
 }
 
 /**
- * 显示等待信息
+ * 获取纬度信息
+ * @return 纬度
  */
-void Display::displayWait() {
-    // 更改显示信息标志
-    _isDisplaying = true;
-
-    // 显示内容
-    u8g.firstPage(); 
-    do {
-        // 设置字体
-        u8g.setFont(u8g_font_unifont);
-        // 选择信息
-        u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, "Please Wait...");
-    } while(u8g.nextPage());
+template <class MODEM, MODEM &modem>
+float LocationUpdateT<MODEM, modem>::getLatitude() {
+    return _latitude;
+}
 
-    delay(2000);
+/**
+ * 获取经度信息
+ * @return 经度
+ */
+template <class MODEM, MODEM &modem>
+float LocationUpdateT<MODEM, modem>::getLongitude() {
+    return _longitude;
 }
 
+// private:
 /**
- * 清空显示信息
+ * 获取当前状态下的定位间隔（内部操作 私有）
+ * @param  state 车辆借还状态
+ * @return       定位间隔（ms 无需定位的状态返回0）
  */
-void Display::displayClear() {
-    // 显示内容
-    u8g.firstPage(); 
-    do {
-        // 设置字体
-        u8g.setFont(u8g_font_unifont);
-        // 选择信息
-        u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-    } while(u8g.nextPage());
+template <class MODEM, MODEM &modem>
+unsigned long LocationUpdateT<MODEM, modem>::getInterval(const RENT_STATE state) {
+    unsigned long interval;
 
-    // 更改显示信息标志
-    _isDisplaying = false;
+    switch (state) {
+        case RENT:
+            interval = CONFIG.get(CONFIG_UPDATE_RENT) * 1000UL;
+        break;
+        case NOT_RENT:
+            interval = CONFIG.get(CONFIG_UPDATE_NOT_RENT) * 1000UL;
+        break;
+        case NOT_AVAILABLE:
+            interval = CONFIG.get(CONFIG_UPDATE_NOT_AVAILABLE) * 1000UL;
+        break;
+        default:
+            return 0;
+        break;
+    }
 
-    delay(DURATION_SHORT);
+    return interval;
 }
 
+
+//////////////////////////////////////
+// ---------- Histogram ----------- //
+//////////////////////////////////////
 /**
- * 显示通讯信息层回复编码
- * @param msg 通讯信息层回复编码
+ * 耗时分布统计工具构造函数
  */
-void Display::displayComMSG(const RESPONSE_MSG msg) {
-    // 更改显示信息标志
-    _isDisplaying = true;
+Histogram::Histogram() {
+    reset();
+}
 
-    // 显示内容
-    u8g.firstPage();
-    do {
-        // 设置字体
-        u8g.setFont(u8g_font_unifont);
+// public:
+/**
+ * 记录一次耗时
+ * @param duration 耗时（us）
+ */
+void Histogram::add(const unsigned long duration) {
+    // 计算分桶
+    int bucket = 0;
+    unsigned long bound = duration >> BUCKET_SHIFT;
+    while (bound != 0 && bucket < BUCKET_COUNT - 1) {
+        bound >>= BUCKET_WIDTH;
+        bucket++;
+    }
 
-        // 选择信息
-        switch(msg) {
-            case RESPONSE_NULL:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case RENT_SUCCESS:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, "Rent Succeed!");
-                }
-            break;
-            case RENT_FAIL_USER_OCCUPIED:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
-                }
-            break;
-            case RENT_FAIL_USER_NONEXISTENT:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
-                }
-            break;
-            case RENT_FAIL_NEGATIVE_BALANCE:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "No Balance");
-                }
-            break;
-            case RENT_FAIL_BIKE_OCCUPIED:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "Bike Occupied");
-                }
-            break;
-            case RENT_FAIL_BIKE_UNAVAILABLE:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "Bike Broken");
-                }
-            break;
-            case RETURN_SUCCESS:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, "Return Success!");
-                }
-            break;
-            case RETURN_FAIL_USER_NOT_MATCH:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Return Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
-                }
-            break;
-            case RETURN_FAIL_ORDER_NONEXISTENT:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Return Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
-                }
-            break;
-            case LOCATION_SUCCESS:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case LOCATION_FAIL:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case LOWBATTERY_SUCCESS:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case LOWBATTERY_FAIL:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case ERROR_REQUEST_OVERTIME:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "No Network");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Again!");
-                }
-            break;
-            case ERROR_STATUS:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
-                }
-            break;
-            case ERROR_INVALID_RESPONSE:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
-                }
-            break;
-            case ERROR_DECODE:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
-                }
-            break;
-            case ERROR_OTHER:
-            default:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
-                }
-            break;
-        }
-    } while(u8g.nextPage());
+    // 计数饱和 不溢出
+    if (_buckets[bucket] < 0xFFFF) {
+        _buckets[bucket]++;
+    }
+    if (_count < 0xFFFF) {
+        _count++;
+    }
 
-    if (isDisplaying()) {
-        // 信息显示时间
-        delay(DURATION);
+    // 累计耗时（ms）
+    _totalRemainder += duration % 1000;
+    _total += duration / 1000 + _totalRemainder / 1000;
+    _totalRemainder %= 1000;
 
-        // 清除显示信息
-        displayClear();
+    if (duration < _min) {
+        _min = duration;
+    }
+    if (duration > _max) {
+        _max = duration;
     }
 }
 
 /**
- * 显示通讯信息层回复详细信息（借还车成功时）
- * @param  msg      显示通讯信息层回复编码
- * @param  userID   用户学号
- * @param  balance  可用余额
- * @param  duration 用车时长
+ * 获取记录次数
+ * @return 记录次数
  */
-void Display::displayDetails(const RESPONSE_MSG msg, const char* userID, const char* balance, const char* duration) {  
-    // 更改显示信息标志
-    _isDisplaying = true;
+unsigned int Histogram::getCount() {
+    return _count;
+}
 
-    // 显示内容
-    u8g.firstPage();
-    do {
-        // 设置字体
-        u8g.setFont(u8g_font_unifont);
+/**
+ * 获取累计耗时
+ * @return 累计耗时（ms）
+ */
+unsigned long Histogram::getTotal() {
+    return _total;
+}
 
-        // 选择信息
-        switch(msg) {
-            case RENT_SUCCESS:
-                u8g.drawStr(LEFT_EDGE, LINE_1_OF_3, "ID:");
-                u8g.setPrintPos(LEFT_TAB_1, LINE_1_OF_3);
-                u8g.print(userID);
-                u8g.drawStr(LEFT_EDGE, LINE_2_OF_3, "Balance:");
-                u8g.setPrintPos(LEFT_TAB_USERID, LINE_2_OF_3);
-                u8g.print(balance);
-            break;
+/**
+ * 获取最大耗时
+ * @return 最大耗时（us）
+ */
+unsigned long Histogram::getMax() {
+    return _max;
+}
+
+/**
+ * 获取最小耗时
+ * @return 最小耗时（us 无记录时返回0）
+ */
+unsigned long Histogram::getMin() {
+    if (_count == 0) {
+        return 0;
+    }
+    return _min;
+}
+
+/**
+ * 获取平均耗时
+ * @return 平均耗时（ms 无记录时返回0）
+ */
+unsigned long Histogram::getAverage() {
+    if (_count == 0) {
+        return 0;
+    }
+    return _total / _count;
+}
+
+/**
+ * 估算耗时百分位数（取所在桶上界 不超过最大耗时）
+ * @param  percent 百分位（1 ~ 100）
+ * @return         百分位耗时（us 无记录时返回0）
+ */
+unsigned long Histogram::getPercentile(const int percent) {
+    if (_count == 0) {
+        return 0;
+    }
+
+    // 目标样本序号（向上取整）
+    unsigned long target = ((unsigned long) _count * percent + 99) / 100;
+    unsigned long counted = 0;
+    for (int i = 0; i < BUCKET_COUNT - 1; i++) {
+        counted += _buckets[i];
+        if (counted >= target) {
+            unsigned long bound = 1UL << (BUCKET_SHIFT + BUCKET_WIDTH * i);
+            return bound < _max ? bound : _max;
+        }
+    }
+
+    return _max;
+}
+
+/**
+ * 生成紧凑统计记录
+ * 格式：次数.累计耗时(ms).最大耗时(ms).桶0-桶1-...（省略末尾空桶）
+ * @return 统计记录
+ */
+String Histogram::toString() {
+    String record = String(_count);
+    record += '.';
+    record += _total;
+    record += '.';
+    record += (_max / 1000);
+    record += '.';
+
+    // 省略末尾空桶
+    int last = BUCKET_COUNT - 1;
+    while (last > 0 && _buckets[last] == 0) {
+        last--;
+    }
+    for (int i = 0; i <= last; i++) {
+        if (i > 0) {
+            record += '-';
+        }
+        record += _buckets[i];
+    }
+
+    return record;
+}
+
+/**
+ * 清空统计
+ */
+void Histogram::reset() {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        _buckets[i] = 0;
+    }
+    _count = 0;
+    _total = 0;
+    _totalRemainder = 0;
+    _min = 0xFFFFFFFF;
+    _max = 0;
+}
+
+
+//////////////////////////////////////
+// --------- RequestArena --------- //
+//////////////////////////////////////
+/**
+ * 单次请求临时内存工具构造函数
+ */
+RequestArena::RequestArena() {
+    _used = 0;
+    _highWater = 0;
+}
+
+// public:
+/**
+ * 分配临时内存
+ * @param  size 大小（byte）
+ * @return      内存地址（空间不足时返回NULL）
+ */
+char* RequestArena::alloc(const unsigned int size) {
+    if (size > ARENA_SIZE - _used) {
+        return NULL;
+    }
+
+    char *block = _buffer + _used;
+    _used += size;
+    if (_used > _highWater) {
+        _highWater = _used;
+    }
+    return block;
+}
+
+/**
+ * 复制字符串至临时内存（自动补充结束符）
+ * @param  str    源字符串
+ * @param  length 复制长度
+ * @return        字符串地址（空间不足时返回NULL）
+ */
+char* RequestArena::copy(const char* str, const unsigned int length) {
+    char *block = alloc(length + 1);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    memcpy(block, str, length);
+    block[length] = '\0';
+    return block;
+}
+
+/**
+ * 追加内容至最近分配的字符串末尾（其后不得再有其他分配 自动补充结束符）
+ * @param  str    追加内容
+ * @param  length 追加长度
+ * @return        true - 成功; false - 空间不足或最近分配的不是字符串
+ */
+bool RequestArena::append(const char* str, const unsigned int length) {
+    if (_used == 0 || _buffer[_used - 1] != '\0' || length > ARENA_SIZE - _used) {
+        return false;
+    }
+
+    // 覆盖原结束符
+    char *block = alloc(length) - 1;
+    memcpy(block, str, length);
+    block[length] = '\0';
+    return true;
+}
+
+/**
+ * 获取已使用空间
+ * @return 已使用空间（byte）
+ */
+unsigned int RequestArena::getUsed() {
+    return _used;
+}
+
+/**
+ * 获取历史最大使用空间
+ * @return 历史最大使用空间（byte）
+ */
+unsigned int RequestArena::getHighWater() {
+    return _highWater;
+}
+
+/**
+ * 整体释放（每次请求开始时调用）
+ */
+void RequestArena::reset() {
+    _used = 0;
+}
+
+
+//////////////////////////////////////
+// --------- RetryPolicy ---------- //
+//////////////////////////////////////
+/**
+ * 重试策略工具构造函数
+ */
+RetryPolicy::RetryPolicy() {
+    _budget = NULL;
+    _timer = TIMER_RETRY;
+    _attempt = 0;
+    _beginAt = 0;
+}
+
+// public:
+/**
+ * 开始新一轮重试
+ * @param budget 重试预算
+ * @param timer  冷却计时所用定时器
+ */
+void RetryPolicy::begin(const RetryBudget &budget, const TIMER_ID timer) {
+    _budget = &budget;
+    _timer = timer;
+    _attempt = 0;
+    _beginAt = sysTime();
+}
+
+/**
+ * 检查是否可再次尝试（首次直接返回 此后先退避等待）
+ * @return true - 可以尝试; false - 预算用尽或冷却中
+ */
+bool RetryPolicy::next() {
+    if (_budget == NULL) {
+        return false;
+    }
+
+    // 上一轮用尽后冷却中
+    if (!TIMER.expired(_timer)) {
+        return false;
+    }
+
+    // 首次尝试不等待
+    if (_attempt == 0) {
+        _attempt++;
+        return true;
+    }
+
+    // 累计阻塞：本轮已过时间（各次请求的指令超时及退避等待）加本次退避
+    unsigned long wait = backoff(*_budget, _attempt);
+    if (!withinBudget(*_budget, _attempt, sysTime() - _beginAt, wait)) {
+        Log(TAG_RETRY, "Budget exhausted after " + String(_attempt) + " attempts");
+        TIMER.start(_timer, _budget->cooldown);
+        return false;
+    }
+
+    Log(TAG_RETRY, "Backoff " + String(wait) + "ms");
+    // 车桩模式退避期间须为其余槽位寻卡（经定时器等待钩子） 不整段休眠
+    if (isLowPower && STATION_SLOT_COUNT == 1) {
+        POWER.sleep(wait);
+    } else {
+        TIMER.hold(wait);
+    }
+    _attempt++;
+    return true;
+}
+
+/**
+ * 获取本轮已尝试次数
+ * @return 尝试次数
+ */
+int RetryPolicy::getAttempt() {
+    return _attempt;
+}
+
+/**
+ * 计算退避时间
+ * 上限内指数增长 在 [1/2, 1] 倍之间随机抖动
+ * @param  budget  重试预算
+ * @param  attempt 已尝试次数
+ * @param  jitter  是否随机抖动（仅车队恢复模拟对比时关闭）
+ * @return         退避时间（ms）
+ */
+unsigned long RetryPolicy::backoff(const RetryBudget &budget, const int attempt, const bool jitter) {
+    unsigned long wait = budget.baseDelay;
+    for (int i = 1; i < attempt && wait < budget.maxDelay; i++) {
+        wait *= 2;
+    }
+    if (wait > budget.maxDelay) {
+        wait = budget.maxDelay;
+    }
+    if (!jitter) {
+        return wait;
+    }
+    return wait / 2 + random(wait / 2 + 1);
+}
+
+/**
+ * 检查本次退避后是否仍在预算内
+ * @param  budget  重试预算
+ * @param  attempt 已尝试次数
+ * @param  blocked 本轮已过时间（ms 各次请求的指令超时及退避等待）
+ * @param  wait    本次退避时间（ms）
+ * @return         true - 可再次尝试; false - 次数或累计阻塞超出预算
+ */
+bool RetryPolicy::withinBudget(const RetryBudget &budget, const int attempt, const unsigned long blocked, const unsigned long wait) {
+    return attempt < budget.maxAttempts && blocked + wait <= budget.maxBlocking;
+}
+
+
+//////////////////////////////////////
+// ----------- HttpCom ------------ //
+//////////////////////////////////////
+/**
+ * 通讯工具构造函数
+ */
+template <class MODEM, MODEM &modem>
+HTTPComT<MODEM, modem>::HTTPComT() {
+    _hasResponse = false;
+    _userID = "";
+    _balance = "";
+    _duration = "";
+    _cardSerial = 0;
+    _request = "";
+    _state = RESPONSE_NULL;
+    _prepared = false;
+    _preparedAt = 0;
+    _stageStatsSent = false;
+    _requestID = 0;
+    _duplicate = false;
+    _json = NULL;
+    _jsonDepth = 0;
+    _jsonInString = false;
+    _jsonEscape = false;
+    _jsonOverflow = false;
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+    _connected = false;
+    _lastActive = 0;
+#endif
+#if COM_TRANSPORT == COM_TRANSPORT_TCP || TELEMETRY_UDP
+    _contextOpen = false;
+#endif
+#if TELEMETRY_UDP
+    _unackedCount = 0;
+    _nextSeq = 1;
+    _udpOpen = false;
+    _serverCacheVersion = 0;
+    _serverConfigVersion = 0;
+    for (int i = 0; i < STATION_SLOT_COUNT; i++) {
+        _availability[i] = RESPONSE_NULL;
+    }
+#endif
+
+    // 预留请求指令空间 避免生成指令时反复分配内存
+    _request.reserve(REQUEST_BUFFER_SIZE);
+}
+
+// public:
+/**
+ * 发送借车请求
+ * @param  bikeID     自行车编号
+ * @param  cardSerial 卡片序列号
+ * @param  requestID  请求编号（补发时沿用）
+ * @return            请求是否成功（仅包括通讯及解码层）
+ *                    true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::requestRent(const int bikeID, const unsigned long cardSerial, const unsigned long requestID) {
+    buildRent(bikeID, cardSerial, requestID);
+
+    // 发送请求
+    return sendRequest();
+}
+
+/**
+ * 发送还车请求
+ * @param  bikeID     自行车编号
+ * @param  cardSerial 卡片序列号
+ * @param  requestID  请求编号（重试时沿用）
+ * @return            请求是否成功（仅包括通讯及解码层）
+ *                    true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::requestReturn(const int bikeID, const unsigned long cardSerial, const unsigned long requestID) {
+    buildReturn(bikeID, cardSerial, requestID);
+
+    // 发送请求
+    return sendRequest();
+}
+
+/**
+ * 报告已开锁但借车被服务器拒绝（乐观开锁或本地授权开锁后）
+ * @param  bikeID     自行车编号
+ * @param  cardSerial 卡片序列号
+ * @return            请求是否成功（仅包括通讯及解码层）
+ *                    true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::requestRejectReport(const int bikeID, const unsigned long cardSerial) {
+    // 借车还车请求
+    beginRequest(REQUEST_CMD_RENT_RETURN, REQUEST_REJECT_REPORT, bikeID);
+    // 卡片序列号
+    appendParam(KEY_CARDSERIAL, cardSerial);
+    // 指令截止符
+    _request += REQUEST_CMD_ENDER;
+
+    // 发送请求
+    return sendRequest();
+}
+
+/**
+ * 发送定位信息
+ * @param  bikeID       自行车编号
+ * @param  longitude    经度
+ * @param  latitude     纬度
+ * @param  batteryLevel 电量信息
+ * @return              请求是否成功（仅包括通讯及解码层）
+ *                      true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::requestLocation(const int bikeID, const float longitude, const float latitude, const float batteryLevel) {
+    buildLocation(bikeID, longitude, latitude, batteryLevel);
+
+    // 发送请求
+    return sendRequest();
+}
+
+/**
+ * 发送定位失败信息
+ * @param  bikeID       自行车编号
+ * @param  batteryLevel 电量信息
+ * @return              请求是否成功（仅包括通讯及解码层）
+ *                      true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::requestLocationFail(const int bikeID, const float batteryLevel) {
+    buildLocationFail(bikeID, batteryLevel);
+
+    // 发送请求
+    return sendRequest();
+}
+
+/**
+ * 发送低电量信息
+ * @param  bikeID       自行车编号
+ * @param  batteryLevel 电量信息
+ * @return              请求是否成功（仅包括通讯及解码层）
+ *                      true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::requestLowBattery(const int bikeID, const float batteryLevel) {
+    buildLowBattery(bikeID, batteryLevel);
+
+    // 发送请求
+    return sendRequest();
+}
+
+/**
+ * 发送耗时统计信息
+ * @param  bikeID  自行车编号
+ * @param  profile 耗时统计记录（Profiler::nextPiece 单段）
+ * @param  boot    启动耗时记录（BootSequence::toString 为空时不发送）
+ * @return         请求是否成功（仅包括通讯及解码层）
+ *                 true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::requestProfile(const int bikeID, const String &profile, const String &boot) {
+    // 耗时统计请求
+    beginRequest(REQUEST_CMD_PROFILE, REQUEST_PROFILE, bikeID);
+    // 统计记录
+    appendParam(KEY_PROFILE, profile);
+    // 启动耗时（仅启动后首次上传）
+    if (boot != "") {
+        appendParam(KEY_BOOT, boot);
+    }
+    // 指令截止符
+    _request += REQUEST_CMD_ENDER;
+
+    // 发送请求
+    return sendRequest();
+}
+
+/**
+ * 检查是否有回复信息（获取回复信息前使用）
+ * @return true - 有; false - 没有
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::hasResponse() {
+    return _hasResponse;
+}
+
+/**
+ * 检查回复是否为服务器重放的重复确认（同一请求编号此前已处理 回复内容为原结果）
+ * @return true - 重复确认; false - 首次处理 / 无回复
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::isDuplicate() {
+    return _hasResponse && _duplicate;
+}
+
+/**
+ * 获取回复信息编码
+ * （获取前请检查是否有回复 hasResponse）
+ * @return state 回复信息编码
+ */
+template <class MODEM, MODEM &modem>
+RESPONSE_MSG HTTPComT<MODEM, modem>::getResponse() {
+    if (_hasResponse) {
+        return _state;
+    } else {
+        return RESPONSE_NULL;
+    }
+}
+
+/**
+ * 获取错误信息编码
+ * （存在通讯及解码层错误 无法获得信息层信息）
+ * @return state 回复信息编码
+ */
+template <class MODEM, MODEM &modem>
+RESPONSE_MSG HTTPComT<MODEM, modem>::getError() {
+    if (_state >= ERROR_STATUS) {
+        _hasResponse = false;
+        return _state;
+    } else {
+        return RESPONSE_NULL;
+    }
+}
+
+/**
+ * 获取回复内容：userID 学生证号
+ * （获取前请检查是否有回复 hasResponse 下次请求前有效）
+ * @return userID 学生证号
+ */
+template <class MODEM, MODEM &modem>
+const char* HTTPComT<MODEM, modem>::getResponse_UserID() {
+    if (_hasResponse) {
+        return _userID;
+    } else {
+        return "";
+    }
+}
+
+/**
+ * 获取回复内容：balance 余额
+ * （获取前请检查是否有回复 hasResponse 下次请求前有效）
+ * @return balance 余额
+ */
+template <class MODEM, MODEM &modem>
+const char* HTTPComT<MODEM, modem>::getResponse_Balance() {
+    if (_hasResponse) {
+        return _balance;
+    } else {
+        return "";
+    }
+}
+
+/**
+ * 获取回复内容：duration 用车时长
+ * （获取前请检查是否有回复 hasResponse 下次请求前有效）
+ * @return duration 用车时长
+ */
+template <class MODEM, MODEM &modem>
+const char* HTTPComT<MODEM, modem>::getResponse_Duration() {
+    if (_hasResponse) {
+        return _duration;
+    } else {
+        return "";
+    }
+}
+
+/**
+ * 获取回复内容：cardSerial 车辆占用者的借车卡片（仅车辆被占用时回复）
+ * （获取前请检查是否有回复 hasResponse 下次请求前有效）
+ * @return cardSerial 卡片序列号（0 - 无）
+ */
+template <class MODEM, MODEM &modem>
+unsigned long HTTPComT<MODEM, modem>::getResponse_CardSerial() {
+    if (_hasResponse) {
+        return _cardSerial;
+    } else {
+        return 0;
+    }
+}
+
+/**
+ * 重置回复 清空回复信息（完成回复信息处理后务必调用）
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::resetResponse() {
+    POWER.wakeModem();
+    clearResponse();
+    _prepared = false;
+    modem.reset_HTTP_HTTPTERM();
+    modem.reset_HTTP_SAPBR_0_1();
+}
+
+/**
+ * 开始新一轮请求重试
+ * @param type 重试类型
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::beginRetry(const RETRY_TYPE type) {
+    _retry[type].begin(RETRY_BUDGETS[type], (TIMER_ID) (TIMER_RETRY + type));
+}
+
+/**
+ * 检查是否可再次请求（按重试策略退避等待）
+ * @param  type 重试类型
+ * @return      true - 可以请求; false - 预算用尽或冷却中
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::retry(const RETRY_TYPE type) {
+    return _retry[type].next();
+}
+
+/**
+ * 预先打开承载并初始化HTTP功能（发现新卡片时调用 与确认卡片过程重叠）
+ * TCP方式下预先建立连接（已有可用连接时直接返回）
+ * 下次请求直接使用 无需重新建立连接
+ * @return true - 成功; false - 失败（下次请求时重新建立）
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::prepare() {
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+    if (isConnected()) {
+        return true;
+    }
+
+    Log(TAG_COM, "Preparing connection...");
+    POWER.wakeModem();
+    return openConnection();
+#else
+    if (_prepared && withinInterval(_preparedAt, sysTime(), PREPARE_TIMEOUT)) {
+        return true;
+    }
+
+    Log(TAG_COM, "Preparing bearer...");
+    POWER.wakeModem();
+    _prepared = false;
+    modem.reset_HTTP_HTTPTERM();
+    modem.reset_HTTP_SAPBR_0_1();
+
+    if (openSession()) {
+        _prepared = true;
+        _preparedAt = sysTime();
+    }
+
+    return _prepared;
+#endif
+}
+
+/**
+ * 取消预先打开的承载（卡片读取中断时调用）
+ * TCP方式下保留连接供后续请求使用（空闲超时后由服务器关闭）
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::cancelPrepare() {
+#if COM_TRANSPORT != COM_TRANSPORT_TCP
+    if (_prepared) {
+        Log(TAG_COM, "Bearer released");
+        POWER.wakeModem();
+        _prepared = false;
+        abortRequest(RESPONSE_NULL);
+    }
+#endif
+}
+
+#if TELEMETRY_UDP
+/**
+ * 以UDP数据报发送定位信息（不等待回复）
+ * @param  slot         槽位
+ * @param  bikeID       自行车编号
+ * @param  longitude    经度
+ * @param  latitude     纬度
+ * @param  batteryLevel 电量信息
+ * @return              数据报是否发出（未发出的记录随下次数据报重发）
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::sendLocation(const int slot, const int bikeID, const float longitude, const float latitude, const float batteryLevel) {
+    TelemetryRecord record = { 0, REQUEST_LOCATION, (unsigned char) slot, bikeID, longitude, latitude, batteryLevel };
+    return pushTelemetry(record);
+}
+
+/**
+ * 以UDP数据报发送定位失败信息（不等待回复）
+ * @param  slot         槽位
+ * @param  bikeID       自行车编号
+ * @param  batteryLevel 电量信息
+ * @return              数据报是否发出（未发出的记录随下次数据报重发）
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::sendLocationFail(const int slot, const int bikeID, const float batteryLevel) {
+    TelemetryRecord record = { 0, REQUEST_LOCATION_FAIL, (unsigned char) slot, bikeID, 0, 0, batteryLevel };
+    return pushTelemetry(record);
+}
+
+/**
+ * 以UDP数据报发送低电量信息（不等待回复）
+ * @param  slot         槽位
+ * @param  bikeID       自行车编号
+ * @param  batteryLevel 电量信息
+ * @return              数据报是否发出（未发出的记录随下次数据报重发）
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::sendLowBattery(const int slot, const int bikeID, const float batteryLevel) {
+    TelemetryRecord record = { 0, REQUEST_LOWBATTERY, (unsigned char) slot, bikeID, 0, 0, batteryLevel };
+    return pushTelemetry(record);
+}
+
+/**
+ * 读取已到达的确认数据报（串口无数据时直接返回 不阻塞）
+ * 单次读取可能包含多条确认 截断的确认直接丢弃（之后的确认为累计确认）
+ * 服务器唤醒开启时网络注册完成后即读取（UDP未打开时亦需转交新短信提示）
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::pollTelemetry() {
+#if SERVER_WAKE
+    bool listening = _udpOpen || BOOT.isDone(BOOT_NETWORK);
+#else
+    bool listening = _udpOpen;
+#endif
+    if (!listening || !modem.checkReadable()) {
+        return;
+    }
+
+    // 回复格式：+RECEIVE,1,<len>:\r\n{"ack":<seq>,"state":<state>,"cacheVersion":<version>,"configVersion":<version>}
+    char buffer[ACK_BUFFER_SIZE + 1];
+    modem.cleanBuffer(buffer, sizeof(buffer));
+    modem.readBuffer(buffer, ACK_BUFFER_SIZE, 1, ACK_CHAR_TIMEOUT);
+
+#if SERVER_WAKE
+    // 同时读到的新短信提示转交唤醒工具
+    WAKE.notify(buffer);
+#endif
+
+    char *start = buffer;
+    while ((start = strchr(start, '{')) != NULL) {
+        char *end = strchr(start, '}');
+        if (end == NULL) {
+            break;
+        }
+        char next = end[1];
+        end[1] = '\0';
+        decodeAck(start);
+        end[1] = next;
+        start = end + 1;
+    }
+}
+
+/**
+ * 检查槽位是否有新确认的车辆可用状态
+ * @param  slot 槽位
+ * @return      true - 有; false - 无
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::hasAvailability(const int slot) {
+    return _availability[slot] != RESPONSE_NULL;
+}
+
+/**
+ * 获取槽位新确认的车辆可用状态（读取后清空）
+ * @param  slot 槽位
+ * @return      LOCATION_SUCCESS / LOCATION_SUCCESS_NOT_AVAILABLE（无新状态时返回RESPONSE_NULL）
+ */
+template <class MODEM, MODEM &modem>
+RESPONSE_MSG HTTPComT<MODEM, modem>::getAvailability(const int slot) {
+    RESPONSE_MSG availability = _availability[slot];
+    _availability[slot] = RESPONSE_NULL;
+    return availability;
+}
+
+/**
+ * 获取未确认记录数
+ * @return 未确认记录数
+ */
+template <class MODEM, MODEM &modem>
+int HTTPComT<MODEM, modem>::getUnacked() {
+    return _unackedCount;
+}
+
+/**
+ * 检查遥测是否停滞（未确认记录已满 视为服务器不可达）
+ * @return true - 停滞; false - 正常
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::isTelemetryStalled() {
+    return _unackedCount >= TELEMETRY_UNACKED_MAX;
+}
+
+/**
+ * 检查是否在等待遥测确认（UDP连接已建立或有未确认记录 确认随时可能到达串口）
+ * @return true - 等待中; false - 无需接收
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::isListening() {
+    return _udpOpen || _unackedCount > 0;
+}
+
+/**
+ * 检查是否需要同步卡片缓存或运行参数（确认中的版本与本地不同 需改用HTTP定位请求下发）
+ * @return true - 需要; false - 不需要
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::needSync() {
+    if (_serverCacheVersion != 0 && _serverCacheVersion != CARDCACHE.getVersion()) {
+        return true;
+    }
+    return _serverConfigVersion != 0 && _serverConfigVersion != CONFIG.getVersion();
+}
+#endif
+
+// private:
+/**
+ * 清空回复信息及单次请求临时内存
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::clearResponse() {
+    _hasResponse = false;
+    _userID = "";
+    _balance = "";
+    _duration = "";
+    _cardSerial = 0;
+    _state = RESPONSE_NULL;
+    _duplicate = false;
+    _arena.reset();
+    _json = NULL;
+    _jsonDepth = 0;
+    _jsonInString = false;
+    _jsonEscape = false;
+    _jsonOverflow = false;
+}
+
+/**
+ * 生成借车请求指令
+ * @param bikeID     自行车编号
+ * @param cardSerial 卡片序列号
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::buildRent(const int bikeID, const unsigned long cardSerial, const unsigned long requestID) {
+    // 借车还车请求
+    beginRequest(REQUEST_CMD_RENT_RETURN, REQUEST_RENT, bikeID);
+    // 卡片序列号
+    appendParam(KEY_CARDSERIAL, cardSerial);
+    // 请求编号
+    appendParam(KEY_REQUEST_ID, requestID);
+    _requestID = requestID;
+    // 指令截止符
+    _request += REQUEST_CMD_ENDER;
+}
+
+/**
+ * 生成还车请求指令
+ * @param bikeID     自行车编号
+ * @param cardSerial 卡片序列号
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::buildReturn(const int bikeID, const unsigned long cardSerial, const unsigned long requestID) {
+    // 借车还车请求
+    beginRequest(REQUEST_CMD_RENT_RETURN, REQUEST_RETURN, bikeID);
+    // 卡片序列号
+    appendParam(KEY_CARDSERIAL, cardSerial);
+    // 请求编号
+    appendParam(KEY_REQUEST_ID, requestID);
+    _requestID = requestID;
+    // 指令截止符
+    _request += REQUEST_CMD_ENDER;
+}
+
+/**
+ * 生成定位信息请求指令
+ * @param bikeID       自行车编号
+ * @param longitude    经度
+ * @param latitude     纬度
+ * @param batteryLevel 电量信息
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::buildLocation(const int bikeID, const float longitude, const float latitude, const float batteryLevel) {
+    // 定位成功请求
+    beginRequest(REQUEST_CMD_LOCATION, REQUEST_LOCATION, bikeID);
+    // 定位经度
+    appendParam(KEY_LONGITUDE, longitude);
+    // 定位纬度
+    appendParam(KEY_LATITUDE, latitude);
+    // 电池电量
+    appendParam(KEY_BATTERYLEVEL, batteryLevel);
+    // 授权卡片缓存版本
+    appendParam(KEY_CACHE_VERSION, (unsigned long) CARDCACHE.getVersion());
+    // 运行参数版本
+    appendParam(KEY_CONFIG_VERSION, (unsigned long) CONFIG.getVersion());
+    // 通讯阶段耗时统计
+    appendStageStats();
+    // 指令截止符
+    _request += REQUEST_CMD_ENDER;
+}
+
+/**
+ * 生成定位失败请求指令
+ * @param bikeID       自行车编号
+ * @param batteryLevel 电量信息
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::buildLocationFail(const int bikeID, const float batteryLevel) {
+    // 定位失败或低电量请求
+    beginRequest(REQUEST_CMD_BATTERY, REQUEST_LOCATION_FAIL, bikeID);
+    // 电池电量
+    appendParam(KEY_BATTERYLEVEL, batteryLevel);
+    // 授权卡片缓存版本
+    appendParam(KEY_CACHE_VERSION, (unsigned long) CARDCACHE.getVersion());
+    // 运行参数版本
+    appendParam(KEY_CONFIG_VERSION, (unsigned long) CONFIG.getVersion());
+    // 通讯阶段耗时统计
+    appendStageStats();
+    // 指令截止符
+    _request += REQUEST_CMD_ENDER;
+}
+
+/**
+ * 生成低电量请求指令
+ * @param bikeID       自行车编号
+ * @param batteryLevel 电量信息
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::buildLowBattery(const int bikeID, const float batteryLevel) {
+    // 定位失败或低电量请求
+    beginRequest(REQUEST_CMD_BATTERY, REQUEST_LOWBATTERY, bikeID);
+    // 电池电量
+    appendParam(KEY_BATTERYLEVEL, batteryLevel);
+    // 指令截止符
+    _request += REQUEST_CMD_ENDER;
+}
+
+/**
+ * 开始生成请求指令（指令头 操作关键字 请求码 车辆编号）
+ * 直接在预留空间内追加 避免生成临时String
+ * @param cmd         通讯操作关键字
+ * @param requestCode 请求码
+ * @param bikeID      自行车编号
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::beginRequest(const String &cmd, const REQUEST_MSG requestCode, const int bikeID) {
+    // 指令开始
+    _request = REQUEST_CMD_HEADER;
+    _request += cmd;
+    // 请求码
+    _request += KEY_STATE;
+    _request += '=';
+    _request += (int) requestCode;
+    // 车辆编号
+    appendParam(KEY_BIKEID, (unsigned long) bikeID);
+    // 默认无请求编号（借车还车请求另行设置）
+    _requestID = 0;
+    // 默认不附带通讯阶段统计（定位信息请求另行追加）
+    _stageStatsSent = false;
+}
+
+/**
+ * 追加请求参数
+ * @param key   参数关键字
+ * @param value 参数值
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::appendParam(const char* key, const unsigned long value) {
+    _request += ',';
+    _request += key;
+    _request += '=';
+    _request += value;
+}
+
+/**
+ * 追加请求参数
+ * @param key   参数关键字
+ * @param value 参数值（保留两位小数）
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::appendParam(const char* key, const float value) {
+    _request += ',';
+    _request += key;
+    _request += '=';
+    _request += value;
+}
+
+/**
+ * 追加请求参数
+ * @param key   参数关键字
+ * @param value 参数值
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::appendParam(const char* key, const String &value) {
+    _request += ',';
+    _request += key;
+    _request += '=';
+    _request += value;
+}
+
+/**
+ * 追加各通讯阶段耗时统计（取自耗时统计工具 无记录时不追加）
+ * 格式：阶段编码.次数.最小.平均.最大.P95（ms）_阶段编码...
+ * 请求成功后才清空 发送失败的统计计入下次定位信息
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::appendStageStats() {
+    bool hasStats = false;
+
+    for (int i = STAGE_STATS_FIRST; i <= STAGE_STATS_LAST; i++) {
+        Histogram *stats = PROFILER.getStage((COM_STAGE) i);
+        if (stats == NULL || stats->getCount() == 0) {
+            continue;
+        }
+
+        if (hasStats) {
+            _request += '_';
+        } else {
+            _request += ',';
+            _request += KEY_COM_STATS;
+            _request += '=';
+            hasStats = true;
+        }
+        _request += i;
+        _request += '.';
+        _request += stats->getCount();
+        _request += '.';
+        _request += (stats->getMin() / 1000);
+        _request += '.';
+        _request += stats->getAverage();
+        _request += '.';
+        _request += (stats->getMax() / 1000);
+        _request += '.';
+        _request += (stats->getPercentile(95) / 1000);
+    }
+
+    _stageStatsSent = hasStats;
+}
+
+/**
+ * 使用通讯模块向服务器发送请求（记录完整请求耗时）
+ * @return         请求是否成功（仅包括通讯及解码层）
+ *                 true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::sendRequest() {
+    unsigned long requestStart = sysTime();
+    unsigned long profileStart = micros();
+
+    bool requestSuccess = exchange();
+
+    PROFILER.record(STAGE_REQUEST, profileStart);
+    // 记录完整请求 附带最终状态
+    Trace(STAGE_REQUEST, requestStart, requestSuccess, String((int) _state));
+
+    // 服务器已收到通讯阶段统计 开始新的统计周期（本次请求各阶段已计入 随之清空）
+    if (requestSuccess && _stageStatsSent) {
+        PROFILER.resetStages();
+    }
+
+    return requestSuccess;
+}
+
+#if COM_TRANSPORT == COM_TRANSPORT_TCP || TELEMETRY_UDP
+/**
+ * 打开移动场景（已打开时直接返回）
+ * 打开前的CIPSHUT会关闭全部连接
+ * @return         true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::openContext() {
+    if (_contextOpen) {
+        return true;
+    }
+
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+    _connected = false;
+#endif
+#if TELEMETRY_UDP
+    _udpOpen = false;
+#endif
+
+    _contextOpen = runStage(STAGE_CIICR);
+    if (!_contextOpen) {
+        Error("CIICR FAIL!");
+    }
+    return _contextOpen;
+}
+#endif
+
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+/**
+ * 通过保持的TCP连接收发请求（无可用连接时先建立连接）
+ * 复用的连接发送失败时（服务器已关闭连接 请求未发出）重连后重发一次
+ * 已发出的请求不重发 避免服务器重复处理
+ * @return         请求是否成功（仅包括通讯及解码层）
+ *                 true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::exchange() {
+    POWER.wakeModem();
+    clearResponse();
+
+    bool reused = isConnected();
+    if (reused) {
+        Log(TAG_COM, "Using kept connection");
+    } else if (!openConnection()) {
+        _state = ERROR_REQUEST_OVERTIME;
+        return false;
+    }
+
+    bool requestSuccess = transmit();
+    if (!requestSuccess && reused && !_connected && _state == ERROR_REQUEST_OVERTIME) {
+        Log(TAG_COM, "Kept connection lost, reconnecting");
+        clearResponse();
+        if (openConnection()) {
+            requestSuccess = transmit();
+        } else {
+            _state = ERROR_REQUEST_OVERTIME;
+        }
+    }
+
+    return requestSuccess;
+}
+
+/**
+ * 检查是否有可复用的TCP连接（空闲未超时）
+ * @return true - 有; false - 无
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::isConnected() {
+    return _connected && withinInterval(_lastActive, sysTime(), KEEPALIVE_TIMEOUT);
+}
+
+/**
+ * 建立TCP连接（移动场景未打开时先打开 原有连接先关闭）
+ * @return         true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::openConnection() {
+    closeConnection();
+
+    if (!openContext()) {
+        return false;
+    }
+
+    _connected = runStage(STAGE_CIPSTART);
+    if (!_connected) {
+        Error("CIPSTART FAIL!");
+        // 移动场景可能已失效 下次重新打开
+        _contextOpen = false;
+        return false;
+    }
+
+    _lastActive = sysTime();
+    return true;
+}
+
+/**
+ * 关闭TCP连接（未建立时直接返回）
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::closeConnection() {
+    if (_connected) {
+        runStage(STAGE_CIPCLOSE);
+        _connected = false;
+    }
+}
+
+/**
+ * 在已建立的连接上发送请求报文并接收解码回复
+ * @return         true - 成功; false - 失败（发送失败时连接已关闭）
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::transmit() {
+    // 发送请求报文
+    if (!runStage(STAGE_CIPSEND)) {
+        Error("CIPSEND FAIL!");
+        closeConnection();
+        _state = ERROR_REQUEST_OVERTIME;
+        return false;
+    }
+
+    // 接收回复报文（JSON位于报文正文 报文头及数据提示不含大括号）
+    unsigned long readStart = sysTime();
+    unsigned long profileStart = micros();
+    bool received = receive();
+    PROFILER.record(STAGE_CIPRECV, profileStart);
+    Trace(STAGE_CIPRECV, readStart, isResponseComplete(), _json != NULL ? _json : "");
+    _lastActive = sysTime();
+
+    if (!received) {
+        Log("Empty response!");
+        closeConnection();
+        _state = ERROR_INVALID_RESPONSE;
+        return false;
+    }
+
+    // 回复信息解码
+    if (!decodeResponse()) {
+        Log("decodeResponse FAIL!");
+        _state = ERROR_DECODE;
+        return false;
+    }
+    Log("decodeResponse SUCCESS!");
+
+    return true;
+}
+
+/**
+ * 从串口分块读取回复报文（含+RECEIVE数据提示及HTTP报文头）并逐块提取JSON
+ * 首块等待回复到达 此后JSON对象完整或字符间隔超时即结束
+ * 服务器关闭连接的提示跨块时无法识别 由下次请求按复用连接失败重发
+ * @return         true - 读到完整JSON对象; false - 超时或超出临时内存
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::receive() {
+    char buffer[RECV_CHUNK_SIZE + 1];
+    unsigned int timeout = RECV_TIMEOUT;
+
+    while (!isResponseComplete() && !_jsonOverflow) {
+        modem.cleanBuffer(buffer, sizeof(buffer));
+        modem.readBuffer(buffer, RECV_CHUNK_SIZE, timeout, RECV_CHAR_TIMEOUT);
+        if (buffer[0] == '\0') {
+            break;
+        }
+
+        // 服务器已关闭或要求关闭连接
+        if (strstr(buffer, "CLOSED") != NULL || strstr(buffer, "Connection: close") != NULL) {
+            _connected = false;
+        }
+
+        feedResponse(buffer, strlen(buffer));
+        timeout = 1;
+    }
+
+    return isResponseComplete();
+}
+#else
+/**
+ * 依次执行通讯模块各阶段指令
+ * @return         请求是否成功（仅包括通讯及解码层）
+ *                 true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::exchange() {
+    POWER.wakeModem();
+    clearResponse();
+    bool requestSuccess = true;
+
+    if (_prepared && withinInterval(_preparedAt, sysTime(), PREPARE_TIMEOUT)) {
+        // 承载及HTTP功能已预先打开
+        Log(TAG_COM, "Using prepared bearer");
+        _prepared = false;
+    } else {
+        _prepared = false;
+        modem.reset_HTTP_HTTPTERM();
+        modem.reset_HTTP_SAPBR_0_1();
+
+        requestSuccess = openSession();
+        if (!requestSuccess) {
+            return requestSuccess;
+        }
+    }
+
+    // 连接到指定URL
+    requestSuccess = runStage(STAGE_HTTPPARA_URL);
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    if (!requestSuccess) {
+        Error("HTTPPARA_URL FAIL!");
+        abortRequest(ERROR_REQUEST_OVERTIME);
+        return requestSuccess;
+    }
+    /*Log("Send request!");*/
+
+    // 发送请求
+    requestSuccess = runStage(STAGE_HTTPACTION);
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    if (!requestSuccess) {
+        Error("HTTPACTION FAIL!");
+        abortRequest(ERROR_REQUEST_OVERTIME);
+        return requestSuccess;
+    }
+
+    // 分块读取服务器返回信息
+    unsigned long readStart = sysTime();
+    unsigned long profileStart = micros();
+    bool received = readResponse();
+    PROFILER.record(STAGE_HTTPREAD, profileStart);
+    Trace(STAGE_HTTPREAD, readStart, received, _json != NULL ? _json : "");
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    if (!received) {
+        requestSuccess = false;
+        Log("Empty response!");
+        abortRequest(ERROR_INVALID_RESPONSE);
+        return requestSuccess;
+    }
+
+    // 回复信息解码
+    requestSuccess = decodeResponse();
+    if (requestSuccess) {
+        Log("decodeResponse SUCCESS!");
+        // 关闭HTTP功能
+        requestSuccess = requestSuccess && runStage(STAGE_HTTPTERM);
+        if (requestSuccess) delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+        // 关闭承载
+        requestSuccess = requestSuccess && runStage(STAGE_SAPBR_0_1);
+        if (requestSuccess) delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    } else {
+        requestSuccess = false;
+        Log("decodeResponse FAIL!");
+        abortRequest(ERROR_DECODE);
+    }
+
+    return requestSuccess;
+}
+
+/**
+ * 打开承载并初始化HTTP功能（与请求内容无关的阶段）
+ * @return         true - 成功; false - 失败（已关闭HTTP功能及承载）
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::openSession() {
+    bool requestSuccess = true;
+
+    // 联网相关
+    requestSuccess = runStage(STAGE_SAPBR_3_1);
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    if (!requestSuccess) {
+        Error("SAPBR_3_1 FAIL!");
+        abortRequest(ERROR_REQUEST_OVERTIME);
+        return requestSuccess;
+    }
+
+    // 打开承载
+    requestSuccess = runStage(STAGE_SAPBR_1_1);
+    if (requestSuccess) {
+        // 长时间停顿
+        delay(CONFIG.get(CONFIG_INTERVAL_LONG));
+    } else {
+        delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+        Error("SAPBR_1_1 FAIL!");
+        abortRequest(ERROR_REQUEST_OVERTIME);
+        return requestSuccess;
+    }
+
+    // 初始化HTTP功能
+    requestSuccess = runStage(STAGE_HTTPINIT);
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    if (!requestSuccess) {
+        Error("HTTPINIT FAIL!");
+        abortRequest(ERROR_REQUEST_OVERTIME);
+        return requestSuccess;
+    }
+
+    requestSuccess = runStage(STAGE_HTTPPARA_CID);
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    if (!requestSuccess) {
+        Error("HTTPPARA_CID FAIL!");
+        abortRequest(ERROR_REQUEST_OVERTIME);
+        return requestSuccess;
+    }
+
+    return requestSuccess;
+}
+
+/**
+ * 分块读取HTTP回复正文并逐块提取JSON（固定缓冲区 不生成整段回复String）
+ * 每块：AT+HTTPREAD=<起始>,<长度> -> +HTTPREAD: <实际长度>\r\n<正文>\r\nOK
+ * 不足一块、JSON对象完整或超出临时内存时结束
+ * @return         true - 读到完整JSON对象; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::readResponse() {
+    unsigned int offset = 0;
+
+    while (!isResponseComplete() && !_jsonOverflow) {
+        String cmd = "AT+HTTPREAD=";
+        cmd += offset;
+        cmd += ',';
+        cmd += READ_CHUNK_SIZE;
+        cmd += "\r\n";
+
+        modem.cleanBuffer(_readBuffer, sizeof(_readBuffer));
+        modem.sendCmd(cmd.c_str());
+        modem.readBuffer(_readBuffer, sizeof(_readBuffer) - 1, READ_TIMEOUT, READ_CHAR_TIMEOUT);
+
+        char *data = strstr(_readBuffer, "+HTTPREAD:");
+        if (data == NULL) {
+            break;
+        }
+        unsigned int length = atoi(data + 10);
+        data = strstr(data, "\r\n");
+        if (data == NULL || length == 0) {
+            break;
+        }
+        data += 2;
+
+        // 仅按实际读到的字节推进 未读到的部分（串口超时截断）下次从该处重新读取
+        unsigned int available = strlen(data);
+        unsigned int fed = min(length, available);
+        if (fed == 0) {
+            break;
+        }
+        feedResponse(data, fed);
+        offset += fed;
+
+        // 已读完最后一块
+        if (fed == length && length < READ_CHUNK_SIZE) {
+            break;
+        }
+    }
+
+    return isResponseComplete();
+}
+#endif
+
+/**
+ * 执行单个通讯阶段指令并记录耗时
+ * @param  stage 通讯阶段（不包括STAGE_HTTPREAD / STAGE_CIPRECV）
+ * @return       true - 成功; false - 失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::runStage(const COM_STAGE stage) {
+    unsigned long stageStart = sysTime();
+    unsigned long profileStart = micros();
+    bool stageSuccess = false;
+
+    switch (stage) {
+#if COM_TRANSPORT == COM_TRANSPORT_TCP || TELEMETRY_UDP
+        case STAGE_CIICR:
+            // 多路连接模式仅能在IP INITIAL状态下设置
+            modem.checkWithCmd("AT+CIPSHUT\r\n", "SHUT OK", CMD);
+            stageSuccess = modem.checkWithCmd("AT+CIPMUX=1\r\n", "OK", CMD) && modem.join();
+        break;
+#endif
+#if TELEMETRY_UDP
+        case STAGE_UDP_START:
+            stageSuccess = modem.checkWithCmd(CMD_UDP_START, "CONNECT OK", CMD);
+        break;
+        case STAGE_UDP_SEND: {
+            String cmd = "AT+CIPSEND=1,";
+            cmd += _request.length();
+            cmd += "\r\n";
+            stageSuccess = modem.checkWithCmd(cmd.c_str(), ">", CMD);
+            if (stageSuccess) {
+                modem.sendCmd(_request.c_str());
+                // 不清空串口 确认数据报可能紧随其后
+                stageSuccess = modem.waitForResp("SEND OK", DATA);
+            }
+            // 记录数据报内容
+            PROFILER.record(stage, profileStart);
+            Trace(stage, stageStart, stageSuccess, _request);
+            return stageSuccess;
+        }
+        break;
+#endif
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+        case STAGE_CIPSTART:
+            stageSuccess = modem.checkWithCmd(CMD_CIPSTART, "CONNECT OK", CMD, CONNECT_TIMEOUT);
+        break;
+        case STAGE_CIPSEND: {
+            String cmd = "AT+CIPSEND=0,";
+            cmd += _request.length();
+            cmd += "\r\n";
+            stageSuccess = modem.checkWithCmd(cmd.c_str(), ">", CMD);
+            if (stageSuccess) {
+                modem.sendCmd(_request.c_str());
+                // 不清空串口 回复报文可能紧随其后
+                stageSuccess = modem.waitForResp("SEND OK", DATA, SEND_TIMEOUT);
+            }
+            // 记录请求内容
+            PROFILER.record(stage, profileStart);
+            Trace(stage, stageStart, stageSuccess, _request);
+            return stageSuccess;
+        }
+        break;
+        case STAGE_CIPCLOSE:
+            stageSuccess = modem.checkWithCmd("AT+CIPCLOSE=0,1\r\n", "CLOSE OK", CMD);
+        break;
+#else
+        case STAGE_SAPBR_3_1:
+            stageSuccess = modem.HTTP_SAPBR_3_1();
+        break;
+        case STAGE_SAPBR_1_1:
+            stageSuccess = modem.HTTP_SAPBR_1_1();
+        break;
+        case STAGE_HTTPINIT:
+            stageSuccess = modem.HTTP_HTTPINIT();
+        break;
+        case STAGE_HTTPPARA_CID:
+            stageSuccess = modem.HTTP_HTTPPARA_CID();
+        break;
+        case STAGE_HTTPPARA_URL:
+            stageSuccess = modem.HTTP_HTTPPARA_URL(_request);
+            // 记录请求内容
+            PROFILER.record(stage, profileStart);
+            Trace(stage, stageStart, stageSuccess, _request);
+            return stageSuccess;
+        break;
+        case STAGE_HTTPACTION:
+            stageSuccess = modem.HTTP_HTTPACTION();
+        break;
+        case STAGE_HTTPTERM:
+            stageSuccess = modem.HTTP_HTTPTERM();
+        break;
+        case STAGE_SAPBR_0_1:
+            stageSuccess = modem.HTTP_SAPBR_0_1();
+        break;
+#endif
+        default:
+        break;
+    }
+
+    PROFILER.record(stage, profileStart);
+    Trace(stage, stageStart, stageSuccess);
+    return stageSuccess;
+}
+
+#if COM_TRANSPORT != COM_TRANSPORT_TCP
+/**
+ * 请求失败时关闭HTTP功能及承载
+ * @param error 通讯及解码层错误编码
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::abortRequest(const RESPONSE_MSG error) {
+    runStage(STAGE_HTTPTERM);
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    runStage(STAGE_SAPBR_0_1);
+    delay(CONFIG.get(CONFIG_INTERVAL_SHORT));
+    _state = error;
+}
+#endif
+
+/**
+ * 逐块提取回复中的JSON对象至单次请求临时内存
+ * 跳过首个左大括号前的内容（数据提示及报文头） 最外层对象闭合后忽略其余内容
+ * @param chunk  回复内容片段
+ * @param length 片段长度
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::feedResponse(const char* chunk, const unsigned int length) {
+    if (_jsonOverflow || isResponseComplete()) {
+        return;
+    }
+
+    unsigned int start = 0;
+    unsigned int end = length;
+    for (unsigned int i = 0; i < length; i++) {
+        char c = chunk[i];
+        if (_json == NULL) {
+            if (c != '{') {
+                continue;
+            }
+            _json = _arena.copy("", 0);
+            if (_json == NULL) {
+                _jsonOverflow = true;
+                Error(TAG_COM + ": Arena Full!");
+                return;
+            }
+            start = i;
+        }
+
+        if (_jsonInString) {
+            if (_jsonEscape) {
+                _jsonEscape = false;
+            } else if (c == '\\') {
+                _jsonEscape = true;
+            } else if (c == '"') {
+                _jsonInString = false;
+            }
+        } else if (c == '"') {
+            _jsonInString = true;
+        } else if (c == '{') {
+            _jsonDepth++;
+        } else if (c == '}') {
+            _jsonDepth--;
+            if (_jsonDepth == 0) {
+                end = i + 1;
+                break;
+            }
+        }
+    }
+
+    if (_json != NULL && !_arena.append(chunk + start, end - start)) {
+        _jsonOverflow = true;
+        Error(TAG_COM + ": Arena Full!");
+    }
+}
+
+/**
+ * 检查是否已提取完整JSON对象
+ * @return true - 完整; false - 未开始 / 未闭合 / 超出临时内存
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::isResponseComplete() {
+    return (_json != NULL) && (_jsonDepth == 0) && !_jsonOverflow;
+}
+
+/**
+ * 按照JSON格式解码已提取的回复信息
+ * JSON内容及解码结果均保存在单次请求临时内存中
+ * aJson节点不经临时内存：aJson库在内部直接malloc/free各节点及字符串 无分配器接口
+ * （替换全局malloc会使String等其余堆分配一并进入临时内存） 节点在本函数返回前全部释放
+ * 长时间运行下堆峰值及碎片是否平稳见 runBenchmark 中的 heapSoak 检查
+ * @return          true - 解码成功; false - 解码失败
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::decodeResponse() {
+    if (!isResponseComplete()) {
+        return false;
+    }
+
+    aJsonObject *msg = aJson.parse(_json);
+    if (msg == NULL) {
+        return false;
+    }
+
+    // 带编号的请求：丢弃此前超时请求的迟到回复（编号以字符串回传 避免整数溢出）
+    if (_requestID != 0) {
+        aJsonObject *JrequestID = aJson.getObjectItem(msg, KEY_REQUEST_ID);
+        if (JrequestID != NULL && JrequestID->valuestring != NULL && strtoul(JrequestID->valuestring, NULL, 10) != _requestID) {
+            Log(TAG_COM, "Stale response: " + String(JrequestID->valuestring));
+            aJson.deleteItem(msg);
+            return false;
+        }
+        aJsonObject *Jduplicate = aJson.getObjectItem(msg, KEY_DUPLICATE);
+        _duplicate = (Jduplicate != NULL && Jduplicate->valueint != 0);
+    }
+    aJsonObject *Jstate = aJson.getObjectItem(msg, KEY_STATE);
+    if (Jstate == NULL) {
+        aJson.deleteItem(msg);
+        return false;
+    }
+    int state = (Jstate->valueint);
+    bool decodeSuccess = true;
+    if ((state == RENT_SUCCESS) || (state == RETURN_SUCCESS)) {
+        aJsonObject *JuserID = aJson.getObjectItem(msg, KEY_USERID);
+        aJsonObject *Jbalance = aJson.getObjectItem(msg, KEY_BALANCE);
+        aJsonObject *Jduration = aJson.getObjectItem(msg, KEY_DURATION);
+        _state = (RESPONSE_MSG) state;
+        _userID = keepString(JuserID);
+        _balance = keepString(Jbalance);
+        _duration = keepString(Jduration);
+    } else {
+        switch(state) {
+            case RENT_FAIL_USER_OCCUPIED:
+            case RENT_FAIL_USER_NONEXISTENT:
+            case RENT_FAIL_NEGATIVE_BALANCE:
+            case RENT_FAIL_BIKE_OCCUPIED:
+            case RENT_FAIL_BIKE_UNAVAILABLE:
+            case REJECT_REPORT_SUCCESS:
+            case RETURN_FAIL_USER_NOT_MATCH:
+            case RETURN_FAIL_ORDER_NONEXISTENT:
+            case LOCATION_SUCCESS:
+            case LOCATION_SUCCESS_NOT_AVAILABLE:
+            case LOCATION_FAIL:
+            case LOWBATTERY_SUCCESS:
+            case LOWBATTERY_FAIL:
+            case PROFILE_SUCCESS:
+            case ERROR_OTHER:
+                _state = (RESPONSE_MSG) state;
+                // 车辆被占用时回复占用者卡片（字符串 避免整数溢出） 用于识别本车此前已成功的借车
+                if (state == RENT_FAIL_BIKE_OCCUPIED) {
+                    aJsonObject *JcardSerial = aJson.getObjectItem(msg, KEY_CARDSERIAL);
+                    if (JcardSerial != NULL && JcardSerial->valuestring != NULL) {
+                        _cardSerial = strtoul(JcardSerial->valuestring, NULL, 10);
+                    }
+                }
+            break;
+            default:
+                decodeSuccess = false;
+            break;
+        }
+    }
+
+    // 授权卡片缓存及运行参数（服务器仅在版本更新时随定位回复下发）
+    if ((state == LOCATION_SUCCESS) || (state == LOCATION_SUCCESS_NOT_AVAILABLE)) {
+        aJsonObject *JcacheVersion = aJson.getObjectItem(msg, KEY_CACHE_VERSION);
+        aJsonObject *Jcards = aJson.getObjectItem(msg, KEY_CARDS);
+        if (JcacheVersion != NULL && Jcards != NULL && Jcards->valuestring != NULL) {
+            if (!CARDCACHE.store(JcacheVersion->valueint, Jcards->valuestring)) {
+                Error(TAG_CACHE + ": Invalid Cache");
+            }
+        }
+
+        aJsonObject *JconfigVersion = aJson.getObjectItem(msg, KEY_CONFIG_VERSION);
+        aJsonObject *Jconfig = aJson.getObjectItem(msg, KEY_CONFIG);
+        if (JconfigVersion != NULL && Jconfig != NULL && Jconfig->valuestring != NULL) {
+            if (!CONFIG.store(JconfigVersion->valueint, Jconfig->valuestring)) {
+                Error(TAG_CONFIG + ": Invalid Config");
+            }
+        }
+    }
+    aJson.deleteItem(msg);
+
+    if (decodeSuccess) {
+        _hasResponse = true;
+    }
+
+    return decodeSuccess;
+}
+
+/**
+ * 将JSON字符串值复制至临时内存（JSON对象释放后仍有效）
+ * @param  item JSON字符串项
+ * @return      字符串（不存在或内存不足时返回空字符串）
+ */
+template <class MODEM, MODEM &modem>
+const char* HTTPComT<MODEM, modem>::keepString(aJsonObject *item) {
+    if (item == NULL || item->valuestring == NULL) {
+        return "";
+    }
+
+    char *str = _arena.copy(item->valuestring, strlen(item->valuestring));
+    if (str == NULL) {
+        Error(TAG_COM + ": Arena Full!");
+        return "";
+    }
+    return str;
+}
+
+#if TELEMETRY_UDP
+/**
+ * 加入遥测记录并发送数据报（包含全部未确认记录）
+ * 未确认记录已满时丢弃最早记录
+ * @param  record 遥测记录（序号在此分配）
+ * @return        数据报是否发出
+ */
+template <class MODEM, MODEM &modem>
+bool HTTPComT<MODEM, modem>::pushTelemetry(const TelemetryRecord &record) {
+    POWER.wakeModem();
+
+    // 先处理已到达的确认 减少重发
+    pollTelemetry();
+
+    if (_unackedCount >= TELEMETRY_UNACKED_MAX) {
+        Error(TAG_TELEMETRY + ": Dropped seq " + String(_unacked[0].seq));
+        for (int i = 1; i < _unackedCount; i++) {
+            _unacked[i - 1] = _unacked[i];
+        }
+        _unackedCount--;
+    }
+    _unacked[_unackedCount] = record;
+    _unacked[_unackedCount].seq = _nextSeq++;
+    _unackedCount++;
+
+    if (!_udpOpen) {
+        if (!openContext()) {
+            return false;
+        }
+        _udpOpen = runStage(STAGE_UDP_START);
+        if (!_udpOpen) {
+            Error("UDP START FAIL!");
+            // 移动场景可能已失效 下次重新打开
+            _contextOpen = false;
+            return false;
+        }
+    }
+
+    buildTelemetry();
+    if (!runStage(STAGE_UDP_SEND)) {
+        Error("UDP SEND FAIL!");
+        _udpOpen = false;
+        return false;
+    }
+
+    Log(TAG_TELEMETRY, "Sent, unacked: " + String(_unackedCount));
+    return true;
+}
+
+/**
+ * 生成遥测数据报（卡片缓存及运行参数版本 及全部未确认记录）
+ * 格式：cacheVersion=版本,configVersion=版本;seq=序号,state=请求码,bikeID=编号,...;seq=...
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::buildTelemetry() {
+    _request = KEY_CACHE_VERSION;
+    _request += '=';
+    _request += CARDCACHE.getVersion();
+    appendParam(KEY_CONFIG_VERSION, (unsigned long) CONFIG.getVersion());
+
+    for (int i = 0; i < _unackedCount; i++) {
+        const TelemetryRecord &record = _unacked[i];
+        _request += ';';
+        _request += KEY_SEQ;
+        _request += '=';
+        _request += record.seq;
+        appendParam(KEY_STATE, (unsigned long) record.type);
+        appendParam(KEY_BIKEID, (unsigned long) record.bikeID);
+        if (record.type == REQUEST_LOCATION) {
+            appendParam(KEY_LONGITUDE, record.longitude);
+            appendParam(KEY_LATITUDE, record.latitude);
+        }
+        appendParam(KEY_BATTERYLEVEL, record.batteryLevel);
+    }
+}
+
+/**
+ * 解码确认数据报 移除已确认记录（累计确认）
+ * 被确认的记录为定位类记录时 记录所属槽位的车辆可用状态
+ * @param json 确认内容（JSON）
+ */
+template <class MODEM, MODEM &modem>
+void HTTPComT<MODEM, modem>::decodeAck(char *json) {
+    aJsonObject *msg = aJson.parse(json);
+    if (msg == NULL) {
+        return;
+    }
+    aJsonObject *Jack = aJson.getObjectItem(msg, KEY_ACK);
+    if (Jack == NULL) {
+        aJson.deleteItem(msg);
+        return;
+    }
+    unsigned int ack = (unsigned int) Jack->valueint;
+
+    // 车辆可用状态（仅在被确认记录仍保留时有效 否则已有更新的确认）
+    aJsonObject *Jstate = aJson.getObjectItem(msg, KEY_STATE);
+    if (Jstate != NULL && (Jstate->valueint == LOCATION_SUCCESS || Jstate->valueint == LOCATION_SUCCESS_NOT_AVAILABLE)) {
+        for (int i = 0; i < _unackedCount; i++) {
+            if (_unacked[i].seq == ack && _unacked[i].slot < STATION_SLOT_COUNT) {
+                _availability[_unacked[i].slot] = (RESPONSE_MSG) Jstate->valueint;
+                break;
+            }
+        }
+    }
+
+    aJsonObject *JcacheVersion = aJson.getObjectItem(msg, KEY_CACHE_VERSION);
+    if (JcacheVersion != NULL) {
+        _serverCacheVersion = (unsigned int) JcacheVersion->valueint;
+    }
+    aJsonObject *JconfigVersion = aJson.getObjectItem(msg, KEY_CONFIG_VERSION);
+    if (JconfigVersion != NULL) {
+        _serverConfigVersion = (unsigned int) JconfigVersion->valueint;
+    }
+    aJson.deleteItem(msg);
+
+    // 移除序号不晚于确认序号的记录（序号回绕安全）
+    int kept = 0;
+    for (int i = 0; i < _unackedCount; i++) {
+        if ((int) (_unacked[i].seq - ack) > 0) {
+            _unacked[kept++] = _unacked[i];
+        }
+    }
+    if (kept != _unackedCount) {
+        Log(TAG_TELEMETRY, "Acked " + String(ack) + ", unacked: " + String(kept));
+    }
+    _unackedCount = kept;
+}
+#endif
+
+
+//////////////////////////////////////
+// ----------- Display ------------ //
+//////////////////////////////////////
+/**
+ * 显示工具构造函数
+ */
+template <class SCREEN, SCREEN &screen>
+DisplayT<SCREEN, screen>::DisplayT() {
+    if (screen.getMode() == U8G_MODE_R3G3B2) {
+        // 八位色模式下使用白色
+        screen.setColorIndex(255);
+    } else if (screen.getMode() == U8G_MODE_GRAY2BIT) {
+        // 二位灰度模式下使用最大灰度（白色）
+        screen.setColorIndex(3);
+    } else if (screen.getMode() == U8G_MODE_BW) {
+        // 一位黑白模式下使用白色
+        screen.setColorIndex(1);        
+    } else if (screen.getMode() == U8G_MODE_HICOLOR) {
+        // 16位色模式下使用白色
+        screen.setHiColorByRGB(255,255,255);
+    }
+
+    _isDisplaying = false;
+}
+
+// public:
+/**
+ * 检查显示屏是否正在显示信息
+ * @return true - 正在显示; false - 无显示
+ */
+template <class SCREEN, SCREEN &screen>
+bool DisplayT<SCREEN, screen>::isDisplaying() {
+    return _isDisplaying;
+}
+
+/**
+ * 显示等待信息
+ * @param hold 是否停留显示（其后紧接耗时操作时无需停留）
+ */
+template <class SCREEN, SCREEN &screen>
+void DisplayT<SCREEN, screen>::displayWait(const bool hold) {
+    // 等待上一条信息停留结束
+    TIMER.wait(TIMER_DISPLAY);
+
+    unsigned long profileStart = micros();
+
+    // 更改显示信息标志
+    _isDisplaying = true;
+
+    // 显示内容
+    screen.firstPage(); 
+    do {
+        // 设置字体
+        screen.setFont(u8g_font_unifont);
+        // 选择信息
+        screen.drawStr(LEFT_INDENT, LINE_1_OF_1, "Please Wait...");
+    } while(screen.nextPage());
+
+    if (hold) {
+        TIMER.start(TIMER_DISPLAY, CONFIG.get(CONFIG_DISPLAY_WAIT));
+    }
+
+    PROFILER.record(PHASE_DISPLAY_WAIT, profileStart);
+}
+
+/**
+ * 清空显示信息
+ */
+template <class SCREEN, SCREEN &screen>
+void DisplayT<SCREEN, screen>::displayClear() {
+    unsigned long profileStart = micros();
+
+    // 显示内容
+    screen.firstPage(); 
+    do {
+        // 设置字体
+        screen.setFont(u8g_font_unifont);
+        // 选择信息
+        screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+    } while(screen.nextPage());
+
+    // 更改显示信息标志
+    _isDisplaying = false;
+    TIMER.cancel(TIMER_DISPLAY);
+
+    delay(DURATION_SHORT);
+
+    PROFILER.record(PHASE_DISPLAY_CLEAR, profileStart);
+}
+
+/**
+ * 显示通讯信息层回复编码
+ * @param msg 通讯信息层回复编码
+ */
+template <class SCREEN, SCREEN &screen>
+void DisplayT<SCREEN, screen>::displayComMSG(const RESPONSE_MSG msg) {
+    // 等待上一条信息停留结束
+    TIMER.wait(TIMER_DISPLAY);
+
+    unsigned long profileStart = micros();
+
+    // 更改显示信息标志
+    _isDisplaying = true;
+
+    // 显示内容
+    screen.firstPage();
+    do {
+        // 设置字体
+        screen.setFont(u8g_font_unifont);
+
+        // 选择信息
+        switch(msg) {
+            case RESPONSE_NULL:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case RENT_SUCCESS:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, "Rent Succeed!");
+                }
+            break;
+            case RENT_FAIL_USER_OCCUPIED:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
+                }
+            break;
+            case RENT_FAIL_USER_NONEXISTENT:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
+                }
+            break;
+            case RENT_FAIL_NEGATIVE_BALANCE:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "No Balance");
+                }
+            break;
+            case RENT_FAIL_BIKE_OCCUPIED:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "Bike Occupied");
+                }
+            break;
+            case RENT_FAIL_BIKE_UNAVAILABLE:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "Bike Broken");
+                }
+            break;
+            case RETURN_SUCCESS:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, "Return Success!");
+                }
+            break;
+            case RETURN_FAIL_USER_NOT_MATCH:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Return Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
+                }
+            break;
+            case RETURN_FAIL_ORDER_NONEXISTENT:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Return Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "System Error");
+                }
+            break;
+            case LOCATION_SUCCESS:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case LOCATION_FAIL:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case LOWBATTERY_SUCCESS:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case LOWBATTERY_FAIL:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case ERROR_REQUEST_OVERTIME:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "No Network");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Again!");
+                }
+            break;
+            case ERROR_STATUS:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
+                }
+            break;
+            case ERROR_INVALID_RESPONSE:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
+                }
+            break;
+            case ERROR_DECODE:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
+                }
+            break;
+            case ERROR_OTHER:
+            default:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_RES);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
+                }
+            break;
+        }
+    } while(screen.nextPage());
+
+    if (isDisplaying()) {
+        // 信息停留时间（到期后由update清除）
+        TIMER.start(TIMER_DISPLAY, CONFIG.get(CONFIG_DISPLAY));
+    }
+
+    PROFILER.record(PHASE_DISPLAY_COM, profileStart);
+}
+
+/**
+ * 显示通讯信息层回复详细信息（借还车成功时）
+ * @param  msg      显示通讯信息层回复编码
+ * @param  userID   用户学号
+ * @param  balance  可用余额
+ * @param  duration 用车时长
+ */
+template <class SCREEN, SCREEN &screen>
+void DisplayT<SCREEN, screen>::displayDetails(const RESPONSE_MSG msg, const char* userID, const char* balance, const char* duration) {
+    // 等待上一条信息停留结束
+    TIMER.wait(TIMER_DISPLAY);
+
+    unsigned long profileStart = micros();
+
+    // 更改显示信息标志
+    _isDisplaying = true;
+
+    // 显示内容
+    screen.firstPage();
+    do {
+        // 设置字体
+        screen.setFont(u8g_font_unifont);
+
+        // 选择信息
+        switch(msg) {
+            case RENT_SUCCESS:
+                screen.drawStr(LEFT_EDGE, LINE_1_OF_3, "ID:");
+                screen.setPrintPos(LEFT_TAB_1, LINE_1_OF_3);
+                screen.print(userID);
+                screen.drawStr(LEFT_EDGE, LINE_2_OF_3, "Balance:");
+                screen.setPrintPos(LEFT_TAB_USERID, LINE_2_OF_3);
+                screen.print(balance);
+            break;
             case RETURN_SUCCESS:
-                u8g.drawStr(LEFT_EDGE, LINE_1_OF_3, "ID:");
-                u8g.setPrintPos(LEFT_TAB_1, LINE_1_OF_3);
-                u8g.print(userID);
-                u8g.drawStr(LEFT_EDGE, LINE_2_OF_3, "Balance:");
-                u8g.setPrintPos(LEFT_TAB_USERID, LINE_2_OF_3);
-                u8g.print(balance);
-                u8g.drawStr(LEFT_EDGE, LINE_3_OF_3, "Duration:");
-                u8g.setPrintPos(LEFT_TAB_USERID, LINE_3_OF_3);
-                u8g.print(duration);
+                screen.drawStr(LEFT_EDGE, LINE_1_OF_3, "ID:");
+                screen.setPrintPos(LEFT_TAB_1, LINE_1_OF_3);
+                screen.print(userID);
+                screen.drawStr(LEFT_EDGE, LINE_2_OF_3, "Balance:");
+                screen.setPrintPos(LEFT_TAB_USERID, LINE_2_OF_3);
+                screen.print(balance);
+                screen.drawStr(LEFT_EDGE, LINE_3_OF_3, "Duration:");
+                screen.setPrintPos(LEFT_TAB_USERID, LINE_3_OF_3);
+                screen.print(duration);
+            break;
+            default:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_COM_DETAILS);
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, CHAR_MSG_ERROR);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
+                }
+            break;
+        }
+    } while(screen.nextPage());
+
+    // 信息停留时间（到期后由update清除）
+    TIMER.start(TIMER_DISPLAY, CONFIG.get(CONFIG_DISPLAY_LONG));
+
+    PROFILER.record(PHASE_DISPLAY_DETAILS, profileStart);
+}
+
+
+
+
+/**
+ * 显示读卡消息
+ * @param msg 读卡消息
+ */
+template <class SCREEN, SCREEN &screen>
+void DisplayT<SCREEN, screen>::displayCardMSG(const CARD_MSG msg) {
+    // 等待上一条信息停留结束
+    TIMER.wait(TIMER_DISPLAY);
+
+    unsigned long profileStart = micros();
+
+    // 更改显示信息标志
+    _isDisplaying = true;
+
+    // 显示内容
+    screen.firstPage();
+    do {
+        // 设置字体
+        screen.setFont(u8g_font_unifont);
+
+        // 选择信息
+        switch(msg) {
+            case NOTHING:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case NEW_CARD_DETECTED:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    displayWait();
+                }
+            break;
+            case NEW_CARD_CONFIRMED:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case SAME_CARD_AGAIN:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case CARD_DETATCHED:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_EDGE, TOP_EDGE, "");
+                    _isDisplaying = false;
+                }
+            break;
+            case CARD_DETATCH_CONFIRMED:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, "Returning...");
+                }
+            break;
+            case CARD_READ_STOP:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "No Card Found");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Again!");
+                }
+            break;
+            case ERROR_DIFFERENT_CARD:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_MSG_ERROR);
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Another One");
+                }
+            break;
+            case ERROR_NOT_AVAILABLE_CARD:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "Bike Broken");
+                }
+            break;
+            case ERROR_OTHER_CARD:
+                if (isDebug) {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
+                    screen.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
+                    screen.print(msg);
+                } else {
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_MSG_ERROR);
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Another One");
+                }
             break;
             default:
                 if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_COM_DETAILS);
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, CHAR_MSG_ERROR);
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_COM_CARD);
+                    screen.drawStr(LEFT_INDENT, LINE_2_OF_2, CHAR_MSG_ERROR);
                 } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
+                    screen.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
                 }
             break;
         }
-    } while(u8g.nextPage());
+    } while(screen.nextPage());
+
+    if (isDisplaying()) {
+        // 信息停留时间（到期后由update清除）
+        TIMER.start(TIMER_DISPLAY, CONFIG.get(CONFIG_DISPLAY));
+    }
+
+    PROFILER.record(PHASE_DISPLAY_CARD, profileStart);
+}
+
+/**
+ * 信息停留到期后清除显示（每循环终止时调用）
+ */
+template <class SCREEN, SCREEN &screen>
+void DisplayT<SCREEN, screen>::update() {
+    if (_isDisplaying && TIMER.expired(TIMER_DISPLAY)) {
+        displayClear();
+    }
+}
+
+// private:
+
+
+//////////////////////////////////////
+// --------- PowerManager --------- //
+//////////////////////////////////////
+#if !BENCHMARK_HOST
+/**
+ * 看门狗中断（仅用于唤醒）
+ */
+ISR(WDT_vect) {
+}
+#endif
+
+/**
+ * 低功耗工具构造函数
+ */
+PowerManager::PowerManager() {
+    _sleptTime = 0;
+    _modemAsleep = false;
+    _interrupted = false;
+}
+
+// public:
+/**
+ * 循环间隔内休眠（loopTerm内调用）
+ * @param duration  休眠时间（ms 通常为寻卡间隔）
+ * @param modemIdle 距下次使用通讯模块的时间（ms）
+ */
+void PowerManager::idle(const unsigned long duration, const unsigned long modemIdle) {
+    if (!isLowPower) {
+        delay(duration);
+        return;
+    }
+
+    // 通讯模块完成启动前不休眠（启动步骤指令不阻塞 休眠指令等待超时会阻塞每次循环并读走启动步骤的回复）
+    if (modemIdle > MODEM_SLEEP_MIN && BOOT.isDone(BOOT_NETWORK)) {
+        sleepModem();
+    }
+    sleep(duration);
+}
+
+/**
+ * 单片机掉电休眠（看门狗定时唤醒 不足一个周期部分使用delay）
+ * 外部中断唤醒时提前结束（被中断的周期按整个周期计入 误差不超过一个看门狗周期）
+ * @param duration 休眠时间（ms）
+ */
+void PowerManager::sleep(const unsigned long duration) {
+    unsigned long remaining = duration;
+    _interrupted = false;
+
+    // 等待日志发送完毕
+    Serial.flush();
+
+#if TELEMETRY_UDP
+    // 等待遥测确认时不掉电休眠（掉电休眠时串口时钟停止 到达的确认数据丢失）
+    if (HTTPCOM.isListening()) {
+        sleepIdle(duration);
+        return;
+    }
+#endif
+
+    while (remaining >= WDT_PERIOD_MIN && !_interrupted) {
+        // 选择不超过剩余时间的最长看门狗周期
+        int period = WDTO_15MS;
+        unsigned long length = WDT_PERIOD_MIN;
+        while (period < WDTO_8S && length * 2 <= remaining) {
+            period++;
+            length *= 2;
+        }
+
+        sleepWDT(period);
+        _sleptTime += length;
+        remaining -= length;
+    }
+
+    if (remaining > 0 && !_interrupted) {
+        delay(remaining);
+    }
+}
+
+/**
+ * 通讯模块进入休眠（串口空闲时自动休眠 收到数据时唤醒）
+ */
+void PowerManager::sleepModem() {
+    if (_modemAsleep) {
+        return;
+    }
+
+    if (sim808.checkWithCmd("AT+CSCLK=2\r\n", "OK", CMD)) {
+        Log(TAG_POWER, "Modem sleeping");
+        _modemAsleep = true;
+    }
+}
+
+/**
+ * 唤醒通讯模块（使用通讯模块前调用 未休眠时无操作）
+ */
+void PowerManager::wakeModem() {
+    if (!_modemAsleep) {
+        return;
+    }
+
+    // 首个字符用于唤醒 可能丢失
+    sim808.sendCmd("AT\r\n");
+    delay(MODEM_WAKE_DELAY);
+    sim808.checkWithCmd("AT+CSCLK=0\r\n", "OK", CMD);
+    _modemAsleep = false;
+    Log(TAG_POWER, "Modem awake");
+}
+
+/**
+ * 结束本次休眠（外部中断内调用）
+ */
+void PowerManager::interruptSleep() {
+    _interrupted = true;
+}
+
+/**
+ * 获取累计休眠时间（休眠期间millis停止计时 由sysTime补偿）
+ * @return 累计休眠时间（ms）
+ */
+unsigned long PowerManager::getSleptTime() {
+    return _sleptTime;
+}
+
+// private:
+/**
+ * 以看门狗中断唤醒的方式掉电休眠一个周期（内部操作 私有）
+ * @param period 看门狗周期（WDTO_15MS ~ WDTO_8S）
+ */
+void PowerManager::sleepWDT(const int period) {
+#if !BENCHMARK_HOST
+    // 关闭ADC
+    byte adcsra = ADCSRA;
+    ADCSRA &= ~_BV(ADEN);
+
+    // 看门狗设为仅中断模式
+    noInterrupts();
+    MCUSR &= ~_BV(WDRF);
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = _BV(WDIE) | ((period & 0x08) ? _BV(WDP3) : 0) | (period & 0x07);
+    interrupts();
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sleep_cpu();
+
+    // 唤醒
+    sleep_disable();
+    wdt_disable();
+    ADCSRA = adcsra;
+#endif
+}
+
+/**
+ * 空闲休眠（内部操作 私有 定时器及串口保持运行 任一中断唤醒后检查时间）
+ * 系统时间由millis继续计时 不计入休眠补偿时间
+ * @param duration 休眠时间（ms）
+ */
+void PowerManager::sleepIdle(const unsigned long duration) {
+    unsigned long start = millis();
+    while (millis() - start < duration && !_interrupted) {
+#if !BENCHMARK_HOST
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        sleep_enable();
+        sleep_cpu();
+        sleep_disable();
+#endif
+    }
+}
+
+
+//////////////////////////////////////
+// -------- BatteryMonitor -------- //
+//////////////////////////////////////
+/**
+ * 电池电量工具构造函数
+ */
+BatteryMonitor::BatteryMonitor() {
+    // 未测得电量前视为满电 避免误报低电量
+    _voltage = VOLTAGE_FULL;
+    _level = 1.00;
+    _hasSample = false;
+    _lastSample = 0;
+    _lastCrossCheck = 0;
+}
+
+// public:
+/**
+ * 更新电量（未到采样间隔时无操作）
+ */
+void BatteryMonitor::update() {
+    if (_hasSample && withinInterval(_lastSample, sysTime(), SAMPLE_INTERVAL)) {
+        return;
+    }
+    _lastSample = sysTime();
+
+    float voltage = sampleVoltage();
+    if (voltage < VOLTAGE_MIN_VALID) {
+        Error("Battery ADC reading invalid: " + String(voltage));
+        return;
+    }
+    filter(voltage);
+}
+
+/**
+ * 以通讯模块读取的电压交叉校验（未到校验间隔时无操作 需通讯模块已唤醒）
+ * @return true - 校验完成; false - 未校验或读取失败
+ */
+bool BatteryMonitor::crossCheck() {
+    if (_lastCrossCheck != 0 && withinInterval(_lastCrossCheck, sysTime(), CROSS_CHECK_INTERVAL)) {
+        return false;
+    }
+    _lastCrossCheck = sysTime();
+
+    // 回复格式：+CBC: <bcs>,<bcl>,<voltage(mV)>
+    char buffer[48];
+    sim808.cleanBuffer(buffer, sizeof(buffer));
+    sim808.sendCmd("AT+CBC\r\n");
+    sim808.readBuffer(buffer, sizeof(buffer) - 1);
+
+    char* p = strstr(buffer, "+CBC:");
+    if (p == NULL) {
+        Error("Battery cross check failed");
+        return false;
+    }
+    p = strchr(p, ',');
+    p = (p != NULL) ? strchr(p + 1, ',') : NULL;
+    if (p == NULL) {
+        Error("Battery cross check failed");
+        return false;
+    }
+    float modemVoltage = atoi(p + 1) / 1000.0;
+
+    Log(TAG_BATTERY, "ADC: " + String(_voltage) + "V, CBC: " + String(modemVoltage) + "V");
+
+    // 偏差过大时以通讯模块读数重置滤波
+    if (!_hasSample || fabs(modemVoltage - _voltage) > CROSS_CHECK_TOLERANCE) {
+        Error("Battery voltage mismatch, using CBC");
+        _hasSample = false;
+        filter(modemVoltage);
+    }
+    return true;
+}
+
+/**
+ * 获取缓存电量
+ * @return 电池电量（小数点后保留两位 0.00 ~ 1.00）
+ */
+float BatteryMonitor::getLevel() {
+    return _level;
+}
+
+/**
+ * 获取滤波后电压
+ * @return 电池电压（V）
+ */
+float BatteryMonitor::getVoltage() {
+    return _voltage;
+}
+
+// private:
+/**
+ * 过采样读取电池电压（内部操作 私有）
+ * @return 电池电压（V）
+ */
+float BatteryMonitor::sampleVoltage() {
+    unsigned long sum = 0;
+    for (int i = 0; i < OVERSAMPLE_COUNT; i++) {
+        sum += analogRead(BATTERY_PIN);
+    }
+    // 抽取 得到高分辨率读数
+    long reading = sum >> OVERSAMPLE_BITS;
+
+    return reading * ADC_REFERENCE / ADC_MAX * DIVIDER_RATIO;
+}
+
+/**
+ * 滤波并换算电量（内部操作 私有）
+ * @param voltage 新读数（V）
+ */
+void BatteryMonitor::filter(const float voltage) {
+    if (_hasSample) {
+        _voltage += FILTER_ALPHA * (voltage - _voltage);
+    } else {
+        _voltage = voltage;
+        _hasSample = true;
+    }
+
+    float level = (_voltage - VOLTAGE_EMPTY) / (VOLTAGE_FULL - VOLTAGE_EMPTY);
+    level = constrain(level, 0.0, 1.0);
+    // 保留两位小数
+    _level = (int) (level * 100 + 0.5) / 100.0;
+}
+
+
+//////////////////////////////////////
+// ------------- Lock ------------- //
+//////////////////////////////////////
+/**
+ * 车锁构造函数
+ */
+template <class PIN>
+LockT<PIN>::LockT() {
+    _pin = LOCK_PINS[0];
+}
+
+/**
+ * 绑定开锁用引脚（车桩模式下各槽位不同）
+ * @param pin 开锁用引脚
+ */
+template <class PIN>
+void LockT<PIN>::attach(const int pin) {
+    _pin = pin;
+    PIN::mode(_pin, OUTPUT);
+    PIN::write(_pin, LOW);
+}
+
+/**
+ * 开锁
+ */
+template <class PIN>
+void LockT<PIN>::unlock() {
+    unsigned long profileStart = micros();
+
+    PIN::write(_pin, HIGH);
+    // 开锁保持时间不可延长 阻塞至到期
+    TIMER.start(TIMER_LOCK, DURATION);
+    TIMER.wait(TIMER_LOCK);
+    PIN::write(_pin, LOW);
+
+    PROFILER.record(PHASE_UNLOCK, profileStart);
+}
+
+
+//////////////////////////////////////
+// ----------- Profiler ----------- //
+//////////////////////////////////////
+/**
+ * 主循环耗时统计工具构造函数
+ */
+Profiler::Profiler() {
+    _lastUpload = 0;
+    _uploadCursor = 0;
+    _pieceEnd = 0;
+}
+
+// public:
+/**
+ * 记录阶段耗时
+ * @param phase 耗时统计阶段
+ * @param start 开始时间（micros）
+ */
+void Profiler::record(const PROFILE_PHASE phase, const unsigned long start) {
+    _phases[phase].add(micros() - start);
+}
+
+/**
+ * 记录通讯阶段耗时
+ * @param stage 通讯阶段
+ * @param start 开始时间（micros）
+ */
+void Profiler::record(const COM_STAGE stage, const unsigned long start) {
+    int phase = findStage(stage);
+    if (phase >= 0) {
+        record((PROFILE_PHASE) phase, start);
+    }
+}
+
+/**
+ * 获取通讯阶段耗时统计（通讯阶段统计随定位信息上传）
+ * @param  stage 通讯阶段
+ * @return       阶段耗时统计（所选通讯方式不统计该阶段时返回NULL）
+ */
+Histogram* Profiler::getStage(const COM_STAGE stage) {
+    int phase = findStage(stage);
+    if (phase < 0) {
+        return NULL;
+    }
+    return &_phases[phase];
+}
+
+/**
+ * 清空通讯阶段统计（附带统计的定位信息发送成功后调用）
+ */
+void Profiler::resetStages() {
+    for (int i = PHASE_COM_STAGE; i < PHASE_COUNT; i++) {
+        if (isStageStats(i)) {
+            _phases[i].reset();
+        }
+    }
+}
+
+/**
+ * 清空单个阶段统计（性能测试后清除测试调用产生的记录）
+ * @param phase 耗时统计阶段
+ */
+void Profiler::resetPhase(const PROFILE_PHASE phase) {
+    _phases[phase].reset();
+}
+
+/**
+ * 检查是否需要上传统计记录
+ * @return true - 需要; false - 不需要
+ */
+bool Profiler::needUpload() {
+    return !withinInterval(_lastUpload, sysTime(), UPLOAD_INTERVAL);
+}
+
+/**
+ * 推迟上传（上传失败时调用 保留未上传的统计 下一周期再试）
+ */
+void Profiler::postponeUpload() {
+    _lastUpload = sysTime();
+    _uploadCursor = 0;
+}
+
+/**
+ * 开始上传（从首个阶段开始分段）
+ */
+void Profiler::beginUpload() {
+    _uploadCursor = 0;
+    _pieceEnd = 0;
+}
+
+/**
+ * 生成下一段紧凑统计记录（仅包括有记录的阶段 通讯阶段统计随定位信息上传 不重复包括）
+ * 每段不超过 UPLOAD_PIECE_LENGTH（单个阶段超出时独占一段）
+ * 格式：阶段编码.阶段统计_阶段编码.阶段统计...
+ * @return 统计记录（已无可上传阶段时为空）
+ */
+String Profiler::nextPiece() {
+    String record = "";
+    int i;
+    for (i = _uploadCursor; i < PHASE_COUNT; i++) {
+        if (_phases[i].getCount() == 0 || isStageStats(i)) {
+            continue;
+        }
+
+        String phase = String(getCode(i));
+        phase += '.';
+        phase += _phases[i].toString();
+
+        if (record != "") {
+            // 本段已满 该阶段留至下一段
+            if (record.length() + 1 + phase.length() > UPLOAD_PIECE_LENGTH) {
+                break;
+            }
+            record += '_';
+        }
+        record += phase;
+    }
+    _pieceEnd = i;
+    return record;
+}
+
+/**
+ * 当前段上传成功（清空该段各阶段统计 全部上传后开始新周期）
+ */
+void Profiler::pieceUploaded() {
+    for (int i = _uploadCursor; i < _pieceEnd; i++) {
+        if (!isStageStats(i)) {
+            _phases[i].reset();
+        }
+    }
+    _uploadCursor = _pieceEnd;
+
+    if (isUploaded()) {
+        _lastUpload = sysTime();
+    }
+}
 
-    // 信息显示时间
-    delay(DURATION_LONG);
+/**
+ * 检查本次上传是否已完成
+ * @return true - 已全部上传; false - 还有待上传的段
+ */
+bool Profiler::isUploaded() {
+    return _uploadCursor >= PHASE_COUNT;
+}
 
-    // 清除显示信息
-    displayClear();
+// private:
+/**
+ * 检查统计阶段是否属于通讯阶段统计（内部操作 私有）
+ * @param  phase 统计阶段编号
+ * @return       true - 是; false - 否
+ */
+bool Profiler::isStageStats(const int phase) {
+    if (phase < PHASE_COM_STAGE) {
+        return false;
+    }
+    COM_STAGE stage = PROFILED_STAGES[phase - PHASE_COM_STAGE];
+    return stage >= STAGE_STATS_FIRST && stage <= STAGE_STATS_LAST;
+}
 
+/**
+ * 查找通讯阶段的统计位置（内部操作 私有）
+ * @param  stage 通讯阶段
+ * @return       统计阶段编号（所选通讯方式不统计该阶段时返回-1）
+ */
+int Profiler::findStage(const COM_STAGE stage) {
+    for (int i = PHASE_COM_STAGE; i < PHASE_COUNT; i++) {
+        if (PROFILED_STAGES[i - PHASE_COM_STAGE] == stage) {
+            return i;
+        }
+    }
+    return -1;
 }
 
+/**
+ * 获取统计阶段的上传编码（内部操作 私有）
+ * 通讯阶段编码固定为 PHASE_COM_STAGE + COM_STAGE 与通讯方式无关
+ * @param  phase 统计阶段编号
+ * @return       上传编码
+ */
+int Profiler::getCode(const int phase) {
+    if (phase < PHASE_COM_STAGE) {
+        return phase;
+    }
+    return PHASE_COM_STAGE + PROFILED_STAGES[phase - PHASE_COM_STAGE];
+}
 
 
 
+//////////////////////////////////////
+// --------- BootSequence --------- //
+//////////////////////////////////////
 /**
- * 显示读卡消息
- * @param msg 读卡消息
+ * 分阶段启动工具构造函数
  */
-void Display::displayCardMSG(const CARD_MSG msg) {
-    // 更改显示信息标志
-    _isDisplaying = true;
+template <class MODEM, MODEM &modem>
+BootSequenceT<MODEM, modem>::BootSequenceT() {
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        _doneAt[i] = 0;
+    }
+    _lastPoll = 0;
+    _reported = false;
+    _modemStep = MODEM_STEP_AT;
+    _awaitingReply = false;
+}
 
-    // 显示内容
-    u8g.firstPage();
-    do {
-        // 设置字体
-        u8g.setFont(u8g_font_unifont);
+// public:
+/**
+ * 记录阶段完成
+ * @param stage 启动阶段
+ */
+template <class MODEM, MODEM &modem>
+void BootSequenceT<MODEM, modem>::mark(const BOOT_STAGE stage) {
+    // 避免与未完成混淆
+    _doneAt[stage] = max(millis(), 1UL);
+    Log(TAG_BOOT, String((int) stage) + " ready at " + String(_doneAt[stage]) + "ms");
+}
 
-        // 选择信息
-        switch(msg) {
-            case NOTHING:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case NEW_CARD_DETECTED:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    displayWait();
-                }
-            break;
-            case NEW_CARD_CONFIRMED:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case SAME_CARD_AGAIN:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case CARD_DETATCHED:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_EDGE, TOP_EDGE, "");
-                    _isDisplaying = false;
-                }
-            break;
-            case CARD_DETATCH_CONFIRMED:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, "Returning...");
-                }
-            break;
-            case CARD_READ_STOP:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "No Card Found");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Again!");
-                }
-            break;
-            case ERROR_DIFFERENT_CARD:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_MSG_ERROR);
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Another One");
-                }
-            break;
-            case ERROR_NOT_AVAILABLE_CARD:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, "Rent Fail!");
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "Bike Broken");
-                }
-            break;
-            case ERROR_OTHER_CARD:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_COM_CARD);
-                    u8g.setPrintPos(LEFT_TAB_2, LINE_1_OF_1);
-                    u8g.print(msg);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_MSG_ERROR);
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, "Try Another One");
-                }
-            break;
-            default:
-                if (isDebug) {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_2, CHAR_COM_CARD);
-                    u8g.drawStr(LEFT_INDENT, LINE_2_OF_2, CHAR_MSG_ERROR);
-                } else {
-                    u8g.drawStr(LEFT_INDENT, LINE_1_OF_1, CHAR_MSG_ERROR);
-                }
-            break;
+/**
+ * 检查阶段是否完成
+ * @param  stage 启动阶段
+ * @return       true - 已完成; false - 未完成
+ */
+template <class MODEM, MODEM &modem>
+bool BootSequenceT<MODEM, modem>::isDone(const BOOT_STAGE stage) {
+    return _doneAt[stage] != 0;
+}
+
+/**
+ * 推进通讯模块启动（每循环调用 按间隔检查 不阻塞）
+ * 每次检查读取上一步指令的回复 成功则进入下一步 再发送当前步骤指令（不等待回复）
+ * 通讯模块响应 -> 全功能模式 -> SIM卡就绪（通讯模块就绪） -> 网络注册完成
+ * @return true - 本次调用时网络注册完成; false - 未完成或早已完成
+ */
+template <class MODEM, MODEM &modem>
+bool BootSequenceT<MODEM, modem>::pollModem() {
+    if (isDone(BOOT_NETWORK)) {
+        return false;
+    }
+    if (_lastPoll != 0 && withinInterval(_lastPoll, sysTime(), MODEM_POLL_INTERVAL)) {
+        return false;
+    }
+    _lastPoll = sysTime();
+
+    if (_awaitingReply) {
+        _awaitingReply = false;
+        if (readStep()) {
+            _modemStep = (MODEM_STEP) (_modemStep + 1);
+            if (_modemStep == MODEM_STEP_CREG) {
+                mark(BOOT_MODEM);
+            } else if (_modemStep == MODEM_STEP_COUNT) {
+                mark(BOOT_NETWORK);
+
+                // 初始电量校验
+                BATTERY.crossCheck();
+                return true;
+            }
         }
-    } while(u8g.nextPage());
+    }
 
-    if (isDisplaying()) {
-        // 信息显示时间
-        delay(DURATION);
+    sendStep();
+    return false;
+}
+
+/**
+ * 获取启动耗时记录
+ * 格式：阶段.完成时间(ms)_阶段.完成时间(ms)...
+ * @return 启动耗时记录
+ */
+template <class MODEM, MODEM &modem>
+String BootSequenceT<MODEM, modem>::toString() {
+    String record = "";
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        if (!isDone((BOOT_STAGE) i)) {
+            continue;
+        }
+        if (record != "") {
+            record += '_';
+        }
+        record += i;
+        record += '.';
+        record += _doneAt[i];
+    }
+    return record;
+}
+
+/**
+ * 检查启动耗时是否已上传
+ * @return true - 已上传; false - 未上传
+ */
+template <class MODEM, MODEM &modem>
+bool BootSequenceT<MODEM, modem>::isReported() {
+    return _reported;
+}
+
+/**
+ * 记录启动耗时已上传
+ */
+template <class MODEM, MODEM &modem>
+void BootSequenceT<MODEM, modem>::setReported() {
+    _reported = true;
+}
+
+// private:
+/**
+ * 发送当前启动步骤指令（内部操作 私有 不等待回复）
+ */
+template <class MODEM, MODEM &modem>
+void BootSequenceT<MODEM, modem>::sendStep() {
+    // 通讯模块休眠时先唤醒（否则指令首字符丢失 回复不完整）
+    POWER.wakeModem();
+
+    switch (_modemStep) {
+        case MODEM_STEP_AT:
+            modem.sendCmd("AT\r\n");
+        break;
+        case MODEM_STEP_CFUN:
+            modem.sendCmd("AT+CFUN=1\r\n");
+        break;
+        case MODEM_STEP_CPIN:
+            modem.sendCmd("AT+CPIN?\r\n");
+        break;
+        case MODEM_STEP_CREG:
+            modem.sendCmd("AT+CREG?\r\n");
+        break;
+        default:
+        return;
+    }
+    _awaitingReply = true;
+}
+
+/**
+ * 读取当前启动步骤的回复（内部操作 私有 串口无数据时直接返回 不阻塞）
+ * @return true - 步骤完成; false - 未响应或未就绪
+ */
+template <class MODEM, MODEM &modem>
+bool BootSequenceT<MODEM, modem>::readStep() {
+    if (!modem.checkReadable()) {
+        return false;
+    }
+
+    char buffer[32];
+    modem.cleanBuffer(buffer, sizeof(buffer));
+    modem.readBuffer(buffer, sizeof(buffer) - 1, 1, REPLY_CHAR_TIMEOUT);
+
+    switch (_modemStep) {
+        case MODEM_STEP_AT:
+        case MODEM_STEP_CFUN:
+            return strstr(buffer, "OK") != NULL;
+        case MODEM_STEP_CPIN:
+            return strstr(buffer, "+CPIN: READY") != NULL;
+        case MODEM_STEP_CREG: {
+            // 回复格式：+CREG: <n>,<stat>（1 本地 5 漫游）
+            char* p = strstr(buffer, "+CREG:");
+            if (p == NULL) {
+                return false;
+            }
+            p = strchr(p, ',');
+            return (p != NULL) && (p[1] == '1' || p[1] == '5');
+        }
+        default:
+        return false;
+    }
+}
+
+
+#if SERVER_WAKE
+//////////////////////////////////////
+// ---------- ServerWake ---------- //
+//////////////////////////////////////
+template <class MODEM, MODEM &modem>
+volatile bool ServerWakeT<MODEM, modem>::_ringing = false;
+
+/**
+ * 服务器唤醒工具构造函数
+ */
+template <class MODEM, MODEM &modem>
+ServerWakeT<MODEM, modem>::ServerWakeT() {
+    _started = false;
+    _messageIndex = 0;
+}
+
+// public:
+/**
+ * 设置短信及RI引脚并开始监听（网络注册完成后调用）
+ * 启动前已收到的短信直接删除（启动后随即定位 无需唤醒）
+ */
+template <class MODEM, MODEM &modem>
+void ServerWakeT<MODEM, modem>::begin() {
+    POWER.wakeModem();
+
+    // 文本模式 新短信存储并提示（+CMTI） 收到数据时RI引脚同样拉低
+    modem.checkWithCmd("AT+CMGF=1\r\n", "OK", CMD);
+    modem.checkWithCmd("AT+CNMI=2,1,0,0,0\r\n", "OK", CMD);
+    modem.checkWithCmd("AT+CFGRI=1\r\n", "OK", CMD);
+    modem.checkWithCmd("AT+CMGDA=\"DEL ALL\"\r\n", "OK", CMD);
+
+    pinMode(RI_PIN, INPUT_PULLUP);
+    _started = true;
+    armInterrupt();
+    Log(TAG_WAKE, "Listening");
+}
+
+/**
+ * 检查是否收到有效唤醒（无新短信提示时不发送任何指令）
+ * RI引脚拉低后读取串口中的新短信提示（UDP遥测时由通讯工具读取并转交） 读取提示位置的短信后删除
+ * @return true - 收到唤醒短信; false - 无唤醒或非唤醒短信
+ */
+template <class MODEM, MODEM &modem>
+bool ServerWakeT<MODEM, modem>::poll() {
+    if (!_started) {
+        return false;
+    }
+
+    if (_ringing) {
+        _ringing = false;
+#if !TELEMETRY_UDP
+        // 新短信提示格式：+CMTI: "SM",<位置>
+        if (modem.checkReadable()) {
+            char buffer[URC_BUFFER_SIZE + 1];
+            modem.cleanBuffer(buffer, sizeof(buffer));
+            modem.readBuffer(buffer, URC_BUFFER_SIZE, 1, URC_CHAR_TIMEOUT);
+            notify(buffer);
+        }
+#endif
+        armInterrupt();
+    }
+
+    if (_messageIndex == 0) {
+        return false;
+    }
+
+    POWER.wakeModem();
+
+    char message[MESSAGE_SIZE + 1];
+    memset(message, 0, sizeof(message));
+    bool hasMessage = modem.readSMS(_messageIndex, message, MESSAGE_SIZE);
+    modem.deleteSMS(_messageIndex);
+    _messageIndex = 0;
+
+    if (!hasMessage) {
+        return false;
+    }
+    if (strncmp(message, WAKE_TOKEN, strlen(WAKE_TOKEN)) != 0) {
+        Error(TAG_WAKE + ": Unknown SMS");
+        return false;
+    }
+    Log(TAG_WAKE, "Wake-up SMS received");
+    return true;
+}
+
+/**
+ * 从串口数据中提取新短信提示的存储位置（由读取串口的工具调用 下次检查时读取该短信）
+ * @param data 串口数据
+ */
+template <class MODEM, MODEM &modem>
+void ServerWakeT<MODEM, modem>::notify(const char* data) {
+    const char *urc = strstr(data, "+CMTI:");
+    if (urc == NULL) {
+        return;
+    }
+    const char *comma = strchr(urc, ',');
+    if (comma != NULL && atoi(comma + 1) > 0) {
+        _messageIndex = atoi(comma + 1);
+    }
+}
+
+// private:
+/**
+ * RI引脚中断（低电平触发 触发后解除 检查完毕后重新开启）
+ */
+template <class MODEM, MODEM &modem>
+void ServerWakeT<MODEM, modem>::onRing() {
+    detachInterrupt(digitalPinToInterrupt(RI_PIN));
+    _ringing = true;
+    POWER.interruptSleep();
+}
+
+/**
+ * 开启RI引脚中断（低电平可唤醒掉电休眠）
+ */
+template <class MODEM, MODEM &modem>
+void ServerWakeT<MODEM, modem>::armInterrupt() {
+    attachInterrupt(digitalPinToInterrupt(RI_PIN), onRing, LOW);
+}
+#endif
+
+
+//////////////////////////////////////
+// -------- RuntimeConfig --------- //
+//////////////////////////////////////
+/**
+ * 运行参数工具构造函数（恢复前使用默认值）
+ */
+RuntimeConfig::RuntimeConfig() {
+    loadDefaults();
+}
+
+// public:
+/**
+ * 从EEPROM恢复运行参数（启动时调用 无有效记录或超出范围时使用默认值）
+ * @return true - 已恢复; false - 使用默认值
+ */
+bool RuntimeConfig::restore() {
+    Block block;
+    EEPROM.get(EEPROM_ADDR_RUNTIME_CONFIG, block);
+    if (block.version == 0 || block.version == 0xFFFF || block.check != checksum(block)) {
+        loadDefaults();
+        return false;
+    }
+
+    for (int i = 0; i < CONFIG_PARAM_COUNT; i++) {
+        if (block.values[i] < CONFIG_RANGES[i].minValue || block.values[i] > CONFIG_RANGES[i].maxValue) {
+            loadDefaults();
+            return false;
+        }
+    }
+
+    _version = block.version;
+    memcpy(_values, block.values, sizeof(_values));
+    Log(TAG_CONFIG, "Restored: " + String(_version));
+    return true;
+}
+
+/**
+ * 保存服务器下发的运行参数并立即生效（版本相同时无操作）
+ * 格式：参数值.参数值...（依次对应CONFIG_PARAM 空字段及省略的末尾参数使用默认值）
+ * 任一参数超出范围时整体丢弃
+ * @param  version 参数版本号（非0）
+ * @param  config  参数块
+ * @return         true - 有效; false - 无效
+ */
+bool RuntimeConfig::store(const unsigned int version, const char* config) {
+    if (version == 0 || version == 0xFFFF) {
+        return false;
+    }
+    if (version == _version) {
+        return true;
+    }
+
+    Block block;
+    block.version = version;
+
+    const char* p = config;
+    for (int i = 0; i < CONFIG_PARAM_COUNT; i++) {
+        block.values[i] = CONFIG_RANGES[i].defaultValue;
+        if (*p == '\0') {
+            continue;
+        }
+
+        if (*p != '.') {
+            char* end;
+            unsigned long value = strtoul(p, &end, 10);
+            if (end == p || (*end != '.' && *end != '\0')) {
+                return false;
+            }
+            if (value < CONFIG_RANGES[i].minValue || value > CONFIG_RANGES[i].maxValue) {
+                return false;
+            }
+            block.values[i] = (unsigned int) value;
+            p = end;
+        }
+        if (*p == '.') {
+            p++;
+        }
+    }
+    // 字段多于参数数
+    if (*p != '\0') {
+        return false;
+    }
+
+    block.check = checksum(block);
+    EEPROM.put(EEPROM_ADDR_RUNTIME_CONFIG, block);
+
+    _version = version;
+    memcpy(_values, block.values, sizeof(_values));
+    Log(TAG_CONFIG, "Config Updated: " + String(version));
+    return true;
+}
+
+/**
+ * 获取运行参数
+ * @param  param 运行参数
+ * @return       参数值（单位见CONFIG_PARAM）
+ */
+unsigned int RuntimeConfig::get(const CONFIG_PARAM param) {
+    return _values[param];
+}
+
+/**
+ * 获取运行参数版本号（随定位信息发送 服务器据此判断是否下发 0 - 默认值）
+ * @return 版本号
+ */
+unsigned int RuntimeConfig::getVersion() {
+    return _version;
+}
 
-        // 清除显示信息
-        displayClear();
+// private:
+/**
+ * 使用默认值（内部操作 私有）
+ */
+void RuntimeConfig::loadDefaults() {
+    _version = 0;
+    for (int i = 0; i < CONFIG_PARAM_COUNT; i++) {
+        _values[i] = CONFIG_RANGES[i].defaultValue;
     }
 }
 
-// private:
+/**
+ * 计算参数块校验（内部操作 私有）
+ * @param  block 参数块
+ * @return       校验字节
+ */
+unsigned char RuntimeConfig::checksum(const Block &block) {
+    const unsigned char* bytes = (const unsigned char*) &block;
+    unsigned char check = 0x5A;
+    for (unsigned int i = 0; i < sizeof(Block) - 1; i++) {
+        check = (check << 1 | check >> 7) ^ bytes[i];
+    }
+    return check;
+}
 
 
 //////////////////////////////////////
-// ------------- Lock ------------- //
+// --------- RequestIds ----------- //
 //////////////////////////////////////
 /**
- * 车锁构造函数
+ * 请求编号工具构造函数（恢复前从1开始分配）
+ */
+RequestIds::RequestIds() {
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        _last[slot] = 0;
+        _reserved[slot] = 0;
+    }
+}
+
+// public:
+/**
+ * 从EEPROM恢复各槽位预留上限（启动时调用 无有效记录时从1开始）
  */
-Lock::Lock() {
-    pinMode(LOCK_PIN, OUTPUT);
+void RequestIds::restore() {
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        Block block;
+        EEPROM.get(EEPROM_ADDR_REQUEST_ID + slot * (int) sizeof(Block), block);
+        if (block.check != checksum(block)) {
+            block.reserved = 0;
+            Log(TAG_REQUEST_ID, "No record: " + String(slot));
+        }
+        _last[slot] = block.reserved;
+        _reserved[slot] = block.reserved;
+    }
 }
 
 /**
- * 开锁
+ * 为新的借车 / 还车操作分配请求编号
+ * 超出预留上限时先写入新上限再返回 保证重启后不会重复分配
+ * @param  slot 槽位编号
+ * @return      请求编号
+ */
+unsigned long RequestIds::issue(const int slot) {
+    _last[slot]++;
+    if (_last[slot] > _reserved[slot]) {
+        Block block;
+        block.reserved = _last[slot] + RESERVE_BLOCK - 1;
+        block.check = checksum(block);
+        EEPROM.put(EEPROM_ADDR_REQUEST_ID + slot * (int) sizeof(Block), block);
+        _reserved[slot] = block.reserved;
+    }
+    return _last[slot];
+}
+
+// private:
+/**
+ * 计算预留记录校验（内部操作 私有）
+ * @param  block 预留记录
+ * @return       校验字节
  */
-void Lock::unlock() {
-    digitalWrite(LOCK_PIN, HIGH);
-    delay(DURATION);
-    digitalWrite(LOCK_PIN, LOW);
+unsigned char RequestIds::checksum(const Block &block) {
+    const unsigned char* bytes = (const unsigned char*) &block;
+    unsigned char check = 0xA5;
+    for (unsigned int i = 0; i < sizeof(Block) - 1; i++) {
+        check = (check << 1 | check >> 7) ^ bytes[i];
+    }
+    return check;
 }
 
 
+//////////////////////////////////////
+// ---------- 驱动绑定 ------------ //
+//////////////////////////////////////
+// 模板成员定义在本文件内 按设备驱动显式实例化
+template class CardT<RFID>;
+template class LocationUpdateT<SIM808Modem, sim808>;
+template class HTTPComT<SIM808Modem, sim808>;
+template class DisplayT<U8GLIB_SH1106_128X64, u8g>;
+template class LockT<ArduinoPin>;
+template class BootSequenceT<SIM808Modem, sim808>;
+#if SERVER_WAKE
+template class ServerWakeT<SIM808Modem, sim808>;
+#endif
+
 
 //////////////////////////////////////
 // --------- 全局工具实例 --------- //
 //////////////////////////////////////
-RentState        RENTSTATE;
-Card             CARD;
+Timer            TIMER;
+RentState        RENTSTATES[STATION_SLOT_COUNT];
+Card             CARDS[STATION_SLOT_COUNT];
+CardCache        CARDCACHE;
+CardHistory      CARDHISTORY;
 LocationUpdate   LOCATION;
 HTTPCom          HTTPCOM;
 Display          DISPLAYS;
-Lock             LOCK;
+Lock             LOCKS[STATION_SLOT_COUNT];
+Profiler         PROFILER;
+PowerManager     POWER;
+BootSequence     BOOT;
+BatteryMonitor   BATTERY;
+RuntimeConfig    CONFIG;
+RequestIds       REQUESTIDS;
+#if SERVER_WAKE
+ServerWake       WAKE;
+#endif
 
 //////////////////////////////////////
 // ----------- 全局函数 ----------- //
 //////////////////////////////////////
 /**
- * 获取系统时间（可能溢出）
+ * 获取系统时间（可能溢出 包括休眠时间）
  * @return 系统时间
  */
 unsigned long sysTime() {
-    return millis();
-}
-
-/**
- * 判断两个时间点之间是否满足间隔（考虑溢出）
- * @param  start    开始时间
- * @param  end      结束时间
- * @param  interval 间隔时间
- * @return          true - 在间隔内
- *                  false - 不在间隔内 / 时间溢出
- */
-inline bool withinInterval(const unsigned long start, const unsigned long end, const unsigned long interval) {
-    // 时间溢出
-    if (end < start) {
-
-        // 时间溢出后需要重置_lastUpdate
-        _lastUpdate = sysTime();
-        return false;
-    }
-
-    // 判断间隔
-    if (end - start < interval) {
-        return true;
-    } else {
-        return false;
-    }
+    return millis() + POWER.getSleptTime();
 }
 
-
 /**
- * 获取电池电量
+ * 获取电池电量（按采样间隔更新 其余时间返回缓存值）
  * @return 电池电量（小数点后保留两位）
- *         （0.00 ~ 1.00 读取错误时返回 -1.00）
+ *         （0.00 ~ 1.00 读数无效时保持上次电量）
  */
 float readBatteryLevel() {
-    // 读取电量
-    
-    // 读取失败
-    return 1.00;
+    BATTERY.update();
+    return BATTERY.getLevel();
 }
 
 
@@ -1443,13 +4504,796 @@ void Error(const String error) {
 
 
 /**
- * 系统初始化（setup函数内调用）
+ * 记录通讯过程（单行输出 便于离线回放）
+ * 格式：TRACE,开始时间,耗时,阶段编码,结果[,数据]
+ * @param stage  通讯阶段
+ * @param start  阶段开始时间
+ * @param result 阶段结果
+ * @param data   附带数据（请求内容 / 回复内容 / 定位信息）
+ */
+void Trace(const COM_STAGE stage, const unsigned long start, const bool result, const String data) {
+    if (isTrace) {
+        String record = TAG_TRACE + ",";
+        record += (String(start) + ",");
+        record += (String(sysTime() - start) + ",");
+        record += (String((int) stage) + ",");
+        record += String((int) result);
+        if (data != "") {
+            record += ("," + data);
+        }
+        Serial.println(record);
+    }
+}
+
+/**
+ * 输出通讯模块原始收发记录（仅isTrace时）
+ * 格式：TAG_TRACE,时间,方向,内容 方向 > 为发送 < 为读到的回复 内容中的回车换行转义为 \r \n
+ * 用于现场抓取通讯过程 回放测试需在主机端按记录顺序模拟回复（主机端回放工具不在本仓库中）
+ * @param direction 方向
+ * @param data 内容
+ */
+void TraceRaw(const char direction, const char *data) {
+    if (isTrace) {
+        Serial.print(TAG_TRACE);
+        Serial.print(',');
+        Serial.print(sysTime());
+        Serial.print(',');
+        Serial.print(direction);
+        Serial.print(',');
+        for (const char *c = data; *c != '\0'; c++) {
+            if (*c == '\r') {
+                Serial.print("\\r");
+            } else if (*c == '\n') {
+                Serial.print("\\n");
+            } else {
+                Serial.print(*c);
+            }
+        }
+        Serial.println();
+    }
+}
+
+/**
+ * 输出等待回复的原始记录（仅isTrace时 回复内容由SIM808库读取并丢弃 仅记录期待内容及是否等到）
+ * @param direction 方向（?）
+ * @param data 期待的回复
+ * @param result 是否等到
+ */
+void TraceRaw(const char direction, const char *data, const bool result) {
+    if (isTrace) {
+        TraceRaw(direction, data);
+        Serial.print(TAG_TRACE);
+        Serial.print(',');
+        Serial.print(sysTime());
+        Serial.print(",=,");
+        Serial.println((int) result);
+    }
+}
+
+#if !BENCHMARK_HOST
+// avr-libc 堆管理（堆起始 / 堆顶 / 空闲链表）
+extern char __heap_start;
+extern char *__brkval;
+struct __freelist {
+    size_t sz;
+    struct __freelist *nx;
+};
+extern struct __freelist *__flp;
+
+// 性能测试堆填充标记及为测试调用预留的栈空间
+static const unsigned char HEAP_PAINT = 0xA5;
+static const int HEAP_PAINT_RUN = 8;        // 连续标记字节数（判定未使用区域）
+static const int STACK_MARGIN = 128;        // byte
+
+/**
+ * 获取堆顶（未分配过时为堆起始）
+ * @return 堆顶地址
+ */
+static char* heapTop() {
+    return (__brkval == 0) ? &__heap_start : __brkval;
+}
+
+/**
+ * 获取剩余内存（堆顶至栈顶间隙 + 空闲链表中已释放的内存块）
+ * @return 剩余内存（byte）
+ */
+int freeMemory() {
+    char top;
+    int free = &top - heapTop();
+    for (struct __freelist *block = __flp; block != NULL; block = block->nx) {
+        free += block->sz + sizeof(size_t);
+    }
+    return free;
+}
+
+/**
+ * 获取已分配内存块数（遍历堆中全部内存块 扣除空闲链表中的内存块）
+ * @return 已分配内存块数
+ */
+static int countAllocations() {
+    int count = 0;
+    for (char *block = &__heap_start; block < heapTop(); block += sizeof(size_t) + *(size_t*) block) {
+        count++;
+    }
+    for (struct __freelist *block = __flp; block != NULL; block = block->nx) {
+        count--;
+    }
+    return count;
+}
+
+/**
+ * 填充堆顶至栈顶间隙（测试后查找被改写的最高位置 得到堆峰值）
+ * @return 填充起始位置（当前堆顶）
+ */
+static char* paintHeap() {
+    char top;
+    char *start = heapTop();
+    for (char *p = start; p < &top - STACK_MARGIN; p++) {
+        *p = HEAP_PAINT;
+    }
+    return start;
+}
+
+/**
+ * 获取测试期间堆峰值增长（自填充起始位置向上查找首段连续标记 已分配但未写入的部分不计）
+ * @param  start 填充起始位置
+ * @return       堆峰值增长（byte）
+ */
+static int heapPeak(char *start) {
+    char top;
+    int run = 0;
+    char *p;
+    for (p = start; p < &top - STACK_MARGIN; p++) {
+        if ((unsigned char) *p != HEAP_PAINT) {
+            run = 0;
+        } else if (++run == HEAP_PAINT_RUN) {
+            return (p - run + 1) - start;
+        }
+    }
+    return p - start;
+}
+
+/**
+ * 获取空闲链表状态（块数增多而最大块不增大即为碎片累积）
+ * @param blocks  空闲内存块数
+ * @param largest 最大空闲内存块（byte）
+ */
+static void freeListState(int &blocks, int &largest) {
+    blocks = 0;
+    largest = 0;
+    for (struct __freelist *block = __flp; block != NULL; block = block->nx) {
+        blocks++;
+        if ((int) block->sz > largest) {
+            largest = block->sz;
+        }
+    }
+}
+#else
+// 主机端构建无avr-libc堆信息 内存各项输出为0（仅耗时有效 且为主机耗时）
+int freeMemory() {
+    return 0;
+}
+
+static int countAllocations() {
+    return 0;
+}
+
+static char* paintHeap() {
+    return NULL;
+}
+
+static int heapPeak(char *start) {
+    return 0;
+}
+
+static void freeListState(int &blocks, int &largest) {
+    blocks = 0;
+    largest = 0;
+}
+#endif
+
+// 单项性能测试开始时状态
+struct BenchState {
+    unsigned long start;            // 开始时间（us）
+    int memory;                     // 剩余内存
+    int allocations;                // 已分配内存块数
+    char *heapStart;                // 堆填充起始位置
+};
+
+/**
+ * 开始单项性能测试（记录内存状态 填充堆间隙 最后记录开始时间）
+ * @param state 测试开始时状态
+ */
+static void benchBegin(BenchState &state) {
+    state.memory = freeMemory();
+    state.allocations = countAllocations();
+    state.heapStart = paintHeap();
+    state.start = micros();
+}
+
+/**
+ * 输出单项性能测试结果（先取全部测量值 再生成输出 输出本身的分配不计入）
+ * 格式：BENCH,测试项,次数,平均耗时(us),剩余内存减少量(byte),未释放内存块数,堆峰值增长(byte)
+ * @param name       测试项
+ * @param iterations 次数
+ * @param state      测试开始时状态
+ */
+static void benchReport(const char* name, const int iterations, const BenchState &state) {
+    unsigned long elapsed = micros() - state.start;
+    int peak = heapPeak(state.heapStart);
+    int retained = state.memory - freeMemory();
+    int allocations = countAllocations() - state.allocations;
+
+    String record = "BENCH,";
+    record += name;
+    record += ',';
+    record += iterations;
+    record += ',';
+    record += (elapsed / iterations);
+    record += ',';
+    record += retained;
+    record += ',';
+    record += allocations;
+    record += ',';
+    record += peak;
+    Serial.println(record);
+}
+
+/**
+ * 原读卡状态判断（转移表改写前的 Card::searchCard 逻辑 仅供等效性检查）
+ */
+class LegacyCardDebounce {
+    public:
+        LegacyCardDebounce() {
+            reset();
+        }
+
+        CARD_MSG step(const bool present, const unsigned long serial) {
+            if (present) {
+                switch (_cardState) {
+                    case CARD_NOT_FOUND:
+                        _cardCounter++;
+                        _cardState = CARD_READING;
+                        return NEW_CARD_DETECTED;
+                    break;
+                    case CARD_READING:
+                        _cardCounter++;
+                        if (_cardCounter > CARD_MIN_READING) {
+                            _cardCounter = 0;
+                            _cardState = CARD_FOUND;
+                            if (_cardSerNum != serial) {
+                                _cardSerNum = serial;
+                                return NEW_CARD_CONFIRMED;
+                            } else {
+                                return SAME_CARD_AGAIN;
+                            }
+                        }
+                    break;
+                    case CARD_FOUND:
+                        if (_cardSerNum != serial) {
+                            _cardCounter = 0;
+                            _cardState = CARD_READING;
+                            _cardSerNum = serial;
+                            return ERROR_DIFFERENT_CARD;
+                        }
+                    break;
+                    case CARD_DETATCHING:
+                        _cardCounter = 0;
+                        _cardCounter++;
+                        _cardState = CARD_READING;
+                        return NEW_CARD_DETECTED;
+                    break;
+                    default:
+                    break;
+                }
+            } else {
+                switch (_cardState) {
+                    case CARD_NOT_FOUND:
+                    break;
+                    case CARD_READING:
+                        _cardCounter = 0;
+                        _cardCounter++;
+                        _cardState = CARD_DETATCHING;
+                        return CARD_DETATCHED;
+                    break;
+                    case CARD_FOUND:
+                        _cardCounter++;
+                        _cardState = CARD_DETATCHING;
+                        return CARD_DETATCHED;
+                    break;
+                    case CARD_DETATCHING:
+                        _cardCounter++;
+                        if (_cardCounter > CARD_MIN_DETATCH) {
+                            CARD_MSG msg = (_cardSerNum != 0) ? CARD_DETATCH_CONFIRMED : CARD_READ_STOP;
+                            reset();
+                            return msg;
+                        }
+                    break;
+                    default:
+                    break;
+                }
+            }
+            return NOTHING;
+        }
+
+        unsigned long getSerNum() {
+            return _cardSerNum;
+        }
+
+    private:
+        unsigned long _cardSerNum;
+        CARD_STATE _cardState;
+        int _cardCounter;
+
+        void reset() {
+            _cardSerNum = 0;
+            _cardState = CARD_NOT_FOUND;
+            _cardCounter = 0;
+        }
+};
+
+/**
+ * 检查转移表与原读卡状态判断是否等效
+ * 随机生成读卡序列（含连续读到 / 连续未读 / 换卡） 逐次比较读卡消息及卡片序列号
+ * 格式：CHECK,cardTransitions,次数,不一致次数
+ * @return true - 等效; false - 存在不一致
+ */
+static bool checkCardTransitions() {
+    const long POLLS = 20000;
+    // 两张卡片交替出现（覆盖换卡及同卡再次读到）
+    const unsigned long SERIALS[2] = { 3735928559UL, 305419896UL };
+
+    CardDebounce<CARD_MIN_READING, CARD_MIN_DETATCH> debounce;
+    LegacyCardDebounce legacy;
+    long mismatches = 0;
+    bool present = false;
+    int serial = 0;
+
+    for (long i = 0; i < POLLS; i++) {
+        // 按段切换有卡 / 无卡 段长覆盖各阈值两侧
+        if (random(CARD_MIN_DETATCH + 2) == 0) {
+            present = !present;
+        }
+        if (random(16) == 0) {
+            serial = 1 - serial;
+        }
+
+        CARD_MSG msg = debounce.step(present, present ? SERIALS[serial] : 0);
+        CARD_MSG expected = legacy.step(present, present ? SERIALS[serial] : 0);
+        if (msg != expected || debounce.getSerNum() != legacy.getSerNum()) {
+            mismatches++;
+        }
+    }
+
+    String record = "CHECK,cardTransitions,";
+    record += (String(POLLS) + ",");
+    record += String(mismatches);
+    Serial.println(record);
+
+    return mismatches == 0;
+}
+
+/**
+ * 经编译时绑定的驱动检查串口（驱动调用方式对比用）
+ * @return true - 串口有数据; false - 无数据
+ */
+template <class MODEM, MODEM &modem>
+static bool boundReadable() {
+    return modem.checkReadable();
+}
+
+/**
+ * 虚函数驱动接口（驱动调用方式对比用 即未采用的可替换驱动方案）
+ */
+class VirtualModem {
+    public:
+        virtual bool checkReadable() = 0;
+};
+
+class VirtualSIM808 : public VirtualModem {
+    public:
+        virtual bool checkReadable() { return sim808_check_readable(); }
+};
+
+/**
+ * 模拟显示模块驱动（显示工具性能测试用 实现 DisplayT 使用的 U8GLIB 接口 只计数不绘制）
+ * 按 SH1106 128x64 的分页方式（8页）重复绘制循环 测得耗时为显示工具自身的信息选择及格式化开销
+ * 不含字模绘制及I2C传输（该部分由实际显示模块决定 见运行时 PHASE_DISPLAY_* 统计）
+ */
+class MockScreen {
+    public:
+        MockScreen() {
+            _page = 0;
+            _draws = 0;
+        }
+
+        int getMode() { return U8G_MODE_BW; }
+        void setColorIndex(const unsigned char index) {}
+        void setHiColorByRGB(const unsigned char r, const unsigned char g, const unsigned char b) {}
+        void setFont(const unsigned char *font) {}
+
+        void firstPage() { _page = 0; }
+        bool nextPage() { return ++_page < PAGE_COUNT; }
+
+        int drawStr(const int x, const int y, const char *text) {
+            _draws++;
+            return strlen(text);
+        }
+        void setPrintPos(const int x, const int y) {}
+        void print(const char *text) { _draws++; }
+        void print(const int number) { _draws++; }
+
+        unsigned long getDraws() { return _draws; }
+
+    private:
+        static const int PAGE_COUNT = 8;
+
+        int _page;
+        unsigned long _draws;       // 累计绘制调用次数
+};
+
+MockScreen mockScreen;
+template class DisplayT<MockScreen, mockScreen>;
+
+/**
+ * 比较完成时间（车队恢复模拟排序用）
+ */
+static int compareTime(const void *a, const void *b) {
+    unsigned long x = *(const unsigned long*) a;
+    unsigned long y = *(const unsigned long*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * 车队恢复模拟（网络中断恢复后全部车辆同时还车 按实际重试策略退避重试）
+ * 虚拟时钟按步推进 服务器以每秒固定处理能力代替 test.php（超出部分视为请求失败 请求耗时与成功时相同）
+ * 退避及预算判断调用 RetryPolicy::backoff / withinBudget 预算为 RETRY_RETURN
+ * 一轮用尽后 用户再次刷卡开始新一轮（冷却时间与 ROUND_GAP 取大者）
+ * 格式：FLEET,抖动,车辆数,请求总数,峰值请求率(/s),排空时间(ms),完成时间p50,p95,p99(ms),用尽轮数,未完成车辆数
+ * @param locks  车辆数
+ * @param jitter 是否随机抖动（false 即全部车辆同步退避）
+ */
+static void simulateFleet(const int locks, const bool jitter) {
+    const RetryBudget &budget = RETRY_BUDGETS[RETRY_RETURN];
+    const unsigned long STEP = 100;                 // ms
+    const unsigned long HORIZON = 600000;           // ms
+    const unsigned long REQUEST_TIME = 2000;        // 单次请求耗时（ms）
+    const unsigned long ROUND_GAP = 10000;          // 用尽后用户再次刷卡的间隔（ms）
+    const int CAPACITY = max(1, locks / 20);        // 服务器每秒处理能力（全部车辆至少需20s）
+
+    unsigned long *nextAt = (unsigned long*) malloc(locks * sizeof(unsigned long));
+    unsigned long *beginAt = (unsigned long*) malloc(locks * sizeof(unsigned long));
+    unsigned long *doneAt = (unsigned long*) malloc(locks * sizeof(unsigned long));
+    unsigned char *attempts = (unsigned char*) malloc(locks);
+    if (nextAt == NULL || beginAt == NULL || doneAt == NULL || attempts == NULL) {
+        Error(TAG_SETUP + ": Fleet simulation out of memory");
+        free(nextAt);
+        free(beginAt);
+        free(doneAt);
+        free(attempts);
+        return;
+    }
+
+    for (int n = 0; n < locks; n++) {
+        nextAt[n] = 0;
+        beginAt[n] = 0;
+        doneAt[n] = 0;
+        attempts[n] = 0;
+    }
+
+    long requests = 0;
+    long exhausted = 0;
+    int pending = locks;
+    int served = 0;                 // 本秒已处理
+    int secondRequests = 0;         // 本秒请求数
+    int peak = 0;
+    unsigned long drain = 0;
+
+    for (unsigned long now = 0; now < HORIZON && pending > 0; now += STEP) {
+        // 每步从随机位置开始 同一步内的请求先到先得
+        int offset = random(locks);
+        for (int k = 0; k < locks; k++) {
+            int n = (offset + k) % locks;
+            if (doneAt[n] != 0 || nextAt[n] > now) {
+                continue;
+            }
+
+            requests++;
+            secondRequests++;
+            attempts[n]++;
+            unsigned long finish = now + REQUEST_TIME;
+            if (served < CAPACITY) {
+                served++;
+                doneAt[n] = finish;
+                drain = finish;
+                pending--;
+                continue;
+            }
+
+            unsigned long wait = RetryPolicy::backoff(budget, attempts[n], jitter);
+            if (RetryPolicy::withinBudget(budget, attempts[n], finish - beginAt[n], wait)) {
+                nextAt[n] = finish + wait;
+            } else {
+                exhausted++;
+                attempts[n] = 0;
+                beginAt[n] = finish + max(budget.cooldown, ROUND_GAP);
+                nextAt[n] = beginAt[n];
+            }
+        }
+
+        if ((now + STEP) % 1000 == 0) {
+            peak = max(peak, secondRequests);
+            secondRequests = 0;
+            served = 0;
+        }
+    }
+
+    // 完成时间分位数（未完成车辆不计）
+    int done = 0;
+    for (int n = 0; n < locks; n++) {
+        if (doneAt[n] != 0) {
+            doneAt[done++] = doneAt[n];
+        }
+    }
+    qsort(doneAt, done, sizeof(unsigned long), compareTime);
+
+    String record = "FLEET,";
+    record += (jitter ? "equal," : "none,");
+    record += (String(locks) + ",");
+    record += (String(requests) + ",");
+    record += (String(peak) + ",");
+    record += (String(drain) + ",");
+    record += (String(done > 0 ? doneAt[(long) done * 50 / 100] : 0) + ",");
+    record += (String(done > 0 ? doneAt[(long) done * 95 / 100] : 0) + ",");
+    record += (String(done > 0 ? doneAt[(long) done * 99 / 100] : 0) + ",");
+    record += (String(exhausted) + ",");
+    record += String(pending);
+
+    free(nextAt);
+    free(beginAt);
+    free(doneAt);
+    free(attempts);
+
+    Serial.println(record);
+}
+
+/**
+ * 测试纯运算路径耗时及内存占用（setup函数内调用 需打开isBenchmark 主机端构建见 BENCHMARK_HOST）
+ * 仅测试不涉及通讯模块及读卡模块的操作 使用独立实例 不影响全局状态（显示工具使用模拟显示模块驱动）
+ */
+void runBenchmark() {
+    const int ITERATIONS = 100;
+    const char* RESPONSE_RENT = "+HTTPREAD: 64\r\n{\"state\":110,\"userID\":\"20170001\",\"balance\":\"12.50\",\"duration\":\"\"}\r\nOK";
+    const char* RESPONSE_LOCATION = "+HTTPREAD: 13\r\n{\"state\":310}\r\nOK";
+    // 按分块读取方式逐块提取
+    const unsigned int CHUNK = 16;
+
+    HTTPCom com;
+    LocationUpdate location;
+    BenchState state;
+    // 测试结果累计（避免无副作用的调用被优化）
+    volatile long sink = 0;
+    int i;
+    unsigned int j;
+
+    // 请求指令生成
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) com.buildRent(1, 3735928559UL, 1);
+    benchReport("buildRent", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) com.buildReturn(1, 3735928559UL, 1);
+    benchReport("buildReturn", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) com.buildLocation(1, 121.43f, 31.03f, 0.87f);
+    benchReport("buildLocation", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) com.buildLocationFail(1, 0.87f);
+    benchReport("buildLocationFail", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) com.buildLowBattery(1, 0.42f);
+    benchReport("buildLowBattery", ITERATIONS, state);
+
+    // 回复信息解码
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) {
+        com.clearResponse();
+        for (j = 0; j < strlen(RESPONSE_RENT); j += CHUNK) {
+            com.feedResponse(RESPONSE_RENT + j, min(CHUNK, strlen(RESPONSE_RENT) - j));
+        }
+        com.decodeResponse();
+    }
+    benchReport("decodeRent", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) {
+        com.clearResponse();
+        for (j = 0; j < strlen(RESPONSE_LOCATION); j += CHUNK) {
+            com.feedResponse(RESPONSE_LOCATION + j, min(CHUNK, strlen(RESPONSE_LOCATION) - j));
+        }
+        com.decodeResponse();
+    }
+    benchReport("decodeLocation", ITERATIONS, state);
+
+    // 长时间运行堆检查（反复生成请求并解码回复 含aJson节点及请求字符串的堆分配 aJson节点不经临时内存 见 decodeResponse）
+    // 分段运行 每段前填充堆间隙 段末取该段堆峰值增长及空闲链表状态（块数增多而最大块不增大即为碎片累积）
+    // 首段之后各段堆峰值增长及空闲内存块数均不超过首段 且剩余内存不减少 视为无泄漏及碎片累积
+    // 逐项输出数值（不生成String） 输出本身不改变堆状态
+    // 格式：SOAK,已运行次数,段内堆峰值增长(byte),剩余内存(byte),空闲内存块数,最大空闲内存块(byte)
+    //       CHECK,heapSoak,次数,是否平稳
+    const int SOAK_SEGMENTS = 8;
+    const int SOAK_SEGMENT_CYCLES = 250;
+    int firstPeak = 0;
+    int firstMemory = 0;
+    int firstBlocks = 0;
+    bool flat = true;
+
+    for (int segment = 0; segment < SOAK_SEGMENTS; segment++) {
+        char *heapStart = paintHeap();
+        for (i = 0; i < SOAK_SEGMENT_CYCLES; i++) {
+            com.buildRent(1, 3735928559UL, 1);
+            com.clearResponse();
+            for (j = 0; j < strlen(RESPONSE_RENT); j += CHUNK) {
+                com.feedResponse(RESPONSE_RENT + j, min(CHUNK, strlen(RESPONSE_RENT) - j));
+            }
+            com.decodeResponse();
+
+            com.buildLocation(1, 121.43f, 31.03f, 0.87f);
+            com.clearResponse();
+            for (j = 0; j < strlen(RESPONSE_LOCATION); j += CHUNK) {
+                com.feedResponse(RESPONSE_LOCATION + j, min(CHUNK, strlen(RESPONSE_LOCATION) - j));
+            }
+            com.decodeResponse();
+        }
+
+        int peak = heapPeak(heapStart);
+        int memory = freeMemory();
+        int blocks;
+        int largest;
+        freeListState(blocks, largest);
+
+        if (segment == 0) {
+            firstPeak = peak;
+            firstMemory = memory;
+            firstBlocks = blocks;
+        } else if (peak > firstPeak || blocks > firstBlocks || memory < firstMemory) {
+            flat = false;
+        }
+
+        Serial.print("SOAK,");
+        Serial.print((long) (segment + 1) * SOAK_SEGMENT_CYCLES);
+        Serial.print(',');
+        Serial.print(peak);
+        Serial.print(',');
+        Serial.print(memory);
+        Serial.print(',');
+        Serial.print(blocks);
+        Serial.print(',');
+        Serial.println(largest);
+    }
+
+    Serial.print("CHECK,heapSoak,");
+    Serial.print((long) SOAK_SEGMENTS * SOAK_SEGMENT_CYCLES);
+    Serial.print(',');
+    Serial.println((int) flat);
+
+    // 读卡防抖状态机（读卡确认 -> 保持 -> 取走确认）
+    CardDebounce<CARD_MIN_READING, CARD_MIN_DETATCH> debounce;
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) sink += debounce.step((i % 20) < 10, 3735928559UL);
+    benchReport("cardDebounce", ITERATIONS, state);
+
+    // 转移表与原读卡状态判断等效性检查
+    checkCardTransitions();
+
+    // 定时判断（起始时间与当前时间均为 sysTime 单位ms）
+    unsigned long base = sysTime();
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) sink += withinInterval(base, sysTime(), 60000);
+    benchReport("withinInterval", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) sink += location.needUpdate(NOT_RENT);
+    benchReport("needUpdate", ITERATIONS, state);
+
+    // 通讯模块驱动调用方式对比（直接调用全局函数 / 经编译时绑定的驱动 / 经虚函数）
+    // 前两项耗时应一致 与虚函数项之差即为模板绑定省去的间接调用开销
+    VirtualSIM808 virtualSIM808;
+    VirtualModem * volatile virtualModem = &virtualSIM808;
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) sink += sim808_check_readable();
+    benchReport("modemGlobal", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) sink += boundReadable<SIM808Modem, sim808>();
+    benchReport("modemBound", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) sink += virtualModem->checkReadable();
+    benchReport("modemVirtual", ITERATIONS, state);
+
+    // 显示工具（模拟显示模块驱动 每次调用后取消停留计时 避免等待上一条信息）
+    // 通讯信息及读卡消息轮流覆盖靠前 / 靠后 / 默认分支
+    const RESPONSE_MSG COM_MSGS[3] = { RENT_FAIL_USER_OCCUPIED, RETURN_FAIL_ORDER_NONEXISTENT, ERROR_REQUEST_OVERTIME };
+    const CARD_MSG CARD_MSGS[3] = { NEW_CARD_DETECTED, CARD_READ_STOP, ERROR_NOT_AVAILABLE_CARD };
+    // 清空显示含固定延时（DURATION_SHORT） 减少次数
+    const int CLEAR_ITERATIONS = 10;
+    DisplayT<MockScreen, mockScreen> display;
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) {
+        display.displayWait(false);
+        TIMER.cancel(TIMER_DISPLAY);
+    }
+    benchReport("displayWait", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < CLEAR_ITERATIONS; i++) display.displayClear();
+    benchReport("displayClear", CLEAR_ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) {
+        display.displayComMSG(COM_MSGS[i % 3]);
+        TIMER.cancel(TIMER_DISPLAY);
+    }
+    benchReport("displayComMSG", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) {
+        display.displayDetails(RETURN_SUCCESS, "20170001", "12.50", "01:23");
+        TIMER.cancel(TIMER_DISPLAY);
+    }
+    benchReport("displayDetails", ITERATIONS, state);
+
+    benchBegin(state);
+    for (i = 0; i < ITERATIONS; i++) {
+        display.displayCardMSG(CARD_MSGS[i % 3]);
+        TIMER.cancel(TIMER_DISPLAY);
+    }
+    benchReport("displayCardMSG", ITERATIONS, state);
+
+    sink += mockScreen.getDraws();
+
+    // 清除测试调用产生的显示阶段统计
+    PROFILER.resetPhase(PHASE_DISPLAY_WAIT);
+    PROFILER.resetPhase(PHASE_DISPLAY_CLEAR);
+    PROFILER.resetPhase(PHASE_DISPLAY_COM);
+    PROFILER.resetPhase(PHASE_DISPLAY_DETAILS);
+    PROFILER.resetPhase(PHASE_DISPLAY_CARD);
+
+    // 车队恢复模拟（同步退避 / 实际使用的随机抖动 对比请求峰值及排空时间）
+    // 目标板内存仅够模拟少量车辆 车队规模的结果需主机端构建（BENCHMARK_HOST）
+    const int FLEET_LOCKS = BENCHMARK_HOST ? 5000 : 100;
+    simulateFleet(FLEET_LOCKS, false);
+    simulateFleet(FLEET_LOCKS, true);
+}
+
+/**
+ * 系统初始化（setup函数内调用 仅本地外设 通讯模块由BOOT.pollModem在主循环内启动）
  * @return true - 成功; false - 失败
  */
 bool setupInit() {
-    delay(1000);
-    rfid.init();
-    return sim808.init();
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        READERS[slot].init();
+        CARDS[slot].attach(&READERS[slot]);
+    }
+    BOOT.mark(BOOT_RFID);
+
+    DISPLAYS.displayClear();
+    BOOT.mark(BOOT_DISPLAY);
+
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        LOCKS[slot].attach(LOCK_PINS[slot]);
+    }
+    BOOT.mark(BOOT_LOCK);
+
+    // 初始电量
+    BATTERY.update();
+    return true;
 }
 
 /**
@@ -1457,11 +5301,22 @@ bool setupInit() {
  * @return true - 成功; false - 失败
  */
 bool loopTerm() {
-    rfid.halt();
-    // 如果有内容显示 则清空显示内容
-    if (DISPLAYS.isDisplaying()) {
-        DISPLAYS.displayClear();
+    unsigned long pollInterval = 0xFFFFFFFF;
+    unsigned long modemIdle = 0xFFFFFFFF;
+
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        READERS[slot].halt();
+        // 空闲时读卡模块掉电
+        CARDS[slot].standby();
+
+        // 以最急迫的槽位为准
+        pollInterval = min(pollInterval, CARDS[slot].getPollInterval());
+        modemIdle = min(modemIdle, LOCATION.getTimeToUpdate(RENTSTATES[slot].getState()));
     }
-    delay(200);
+
+    // 如果有内容显示且停留到期 则清空显示内容
+    DISPLAYS.update();
+    // 按读卡状态休眠至下次寻卡
+    POWER.idle(pollInterval, modemIdle);
     return true;
 }
\ No newline at end of file
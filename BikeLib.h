@@ -6,9 +6,33 @@
 #include <aJSON.h>
 #include <RFID.h>
 #include <U8glib.h>
+#include <EEPROM.h>
+
+// 主机端性能测试构建（在主机端Arduino核心 如EpoxyDuino 上编译 仅运行 runBenchmark）
+// 0: 目标板构建
+// 1: 主机端构建 去除休眠及avr-libc堆统计（内存各项输出为0） 通讯 / 读卡 / 显示模块库仅需头文件替身（性能测试不调用）
+#ifndef BENCHMARK_HOST
+#define BENCHMARK_HOST 0
+#endif
+
+#if !BENCHMARK_HOST
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#else
+// 看门狗周期编号（同 avr/wdt.h 主机端构建不休眠 仅供编译）
+#define WDTO_15MS 0
+#define WDTO_8S 9
+#endif
 
 // 调试标志
 static bool isDebug = true;
+// 通讯记录标志（记录与通讯模块交互的各阶段及时间戳 以及经驱动收发的原始内容 用于离线分析）
+// 仅提供抓取 本仓库无主机端构建 回放工具（按记录模拟通讯模块回复）需在仓库外实现
+static bool isTrace = false;
+// 性能测试标志（启动时测试纯运算路径耗时及内存占用 主机端构建时总是测试）
+static bool isBenchmark = BENCHMARK_HOST;
+// 低功耗标志（循环间隔内单片机及通讯模块休眠 关闭时使用delay）
+static bool isLowPower = true;
 
 // 模块日志标签
 const String TAG_SETUP = "SETUP";
@@ -25,18 +49,130 @@ const String TAG_COM = "COM";
 const String TAG_COM_MSG = "RESPONSE_MSG";
 const String TAG_COM_RES = "COM_RES";
 const String TAG_COM_DETAILS = "COM_DETAILS";
+const String TAG_RETRY = "RETRY";
+const String TAG_TELEMETRY = "TELEMETRY";
 
 const String TAG_LOCK = "LOCK";
 
+const String TAG_CACHE = "CARD_CACHE";
+const String TAG_JOURNAL = "JOURNAL";
+const String TAG_CONFIG = "CONFIG";
+const String TAG_REQUEST_ID = "REQUEST_ID";
+
+const String TAG_POWER = "POWER";
+const String TAG_BATTERY = "BATTERY";
+
+const String TAG_BOOT = "BOOT";
+const String TAG_WAKE = "WAKE";
+
+const String TAG_TRACE = "TRACE";
+const String TAG_PROFILE = "PROFILE";
+
+
+//////////////////////////////////////
+// ---------- 车桩模式 ------------ //
+//////////////////////////////////////
+// 槽位数（单车为1 车桩模式下一块主控驱动多个读卡模块及车锁 共用通讯模块）
+// 各槽位引脚见 BikeLib.cpp 中 STATION_READERS / STATION_LOCK_PINS 车辆编号见 BikeTest.ino 中 STATION_BIKEIDS（个数均须等于槽位数）
+#ifndef STATION_SLOT_COUNT
+#define STATION_SLOT_COUNT 1
+#endif
+
+// 最大槽位数（受EEPROM借还状态日志分区限制）
+const int STATION_SLOT_MAX = 8;
+static_assert(STATION_SLOT_COUNT > 0 && STATION_SLOT_COUNT <= STATION_SLOT_MAX, "Invalid station slot count");
+
+
+//////////////////////////////////////
+// ---------- 通讯方式 ------------ //
+//////////////////////////////////////
+// HTTP: 通讯模块内置HTTP功能 每次请求依次执行承载/HTTPINIT/HTTPPARA/HTTPACTION/HTTPREAD等指令
+// TCP:  多路连接模式下保持一条TCP连接（CIPSTART） 直接收发手工生成的HTTP/1.1报文
+#define COM_TRANSPORT_HTTP  0
+#define COM_TRANSPORT_TCP   1
+#ifndef COM_TRANSPORT
+#define COM_TRANSPORT COM_TRANSPORT_HTTP
+#endif
+
+// 遥测（定位 / 定位失败 / 低电量信息）
+// 0: 随HTTP请求同步发送并等待回复
+// 1: UDP数据报发送 不等待回复 确认及车辆可用状态随之后到达的确认数据报下发
+#ifndef TELEMETRY_UDP
+#define TELEMETRY_UDP 0
+#endif
+
+// UDP方式下保留的未确认记录数（随每条数据报重发 超出时丢弃最早记录 全部未确认视为服务器不可达）
+#ifndef TELEMETRY_UNACKED_MAX
+#define TELEMETRY_UNACKED_MAX 4
+#endif
+
+// 服务器唤醒：收到短信（或数据）时通讯模块RI引脚拉低 唤醒单片机并立即定位交换状态
+// 启用后空闲状态定位间隔大幅延长（需连接RI引脚 见 BikeLib.cpp 中 RI_PIN）
+#ifndef SERVER_WAKE
+#define SERVER_WAKE 0
+#endif
+
+
+/**
+ * 记录通讯模块原始收发内容（isTrace 打开时 见 BikeLib.cpp 中 TraceRaw）
+ */
+void TraceRaw(const char direction, const char *data);
+void TraceRaw(const char direction, const char *data, const bool result);
+
+/**
+ * 通讯定位模块驱动（默认驱动 在SIM808库基础上提供AT指令收发）
+ * SIM808库的AT指令收发为全局函数 经本驱动转发 使通讯相关工具仅通过编译时绑定的驱动访问通讯模块
+ * 经本驱动的收发同时记录原始内容（发送指令 / 读到的回复 / 等待的回复及是否等到）
+ * SIM808库内部完成的交互（HTTP_* / GPS）不经本驱动 仅有 Trace 的阶段记录
+ * 转发函数均为内联 不增加数据成员
+ */
+class SIM808Modem : public DFRobot_SIM808 {
+    public:
+        SIM808Modem(HardwareSerial *serial) : DFRobot_SIM808(serial) {}
+
+        bool checkReadable() { return sim808_check_readable(); }
+        void cleanBuffer(char *buffer, const int count) { sim808_clean_buffer(buffer, count); }
+        int readBuffer(char *buffer, const int count, const unsigned int timeout = DEFAULT_TIMEOUT, const unsigned int charTimeout = DEFAULT_INTERCHAR_TIMEOUT) {
+            int length = sim808_read_buffer(buffer, count, timeout, charTimeout);
+            TraceRaw('<', buffer);
+            return length;
+        }
+        void sendCmd(const char *cmd) {
+            TraceRaw('>', cmd);
+            sim808_send_cmd(cmd);
+        }
+        bool checkWithCmd(const char *cmd, const char *resp, const DataType type, const unsigned int timeout = DEFAULT_TIMEOUT, const unsigned int charTimeout = DEFAULT_INTERCHAR_TIMEOUT) {
+            sendCmd(cmd);
+            return waitForResp(resp, type, timeout, charTimeout);
+        }
+        bool waitForResp(const char *resp, const DataType type, const unsigned int timeout = DEFAULT_TIMEOUT, const unsigned int charTimeout = DEFAULT_INTERCHAR_TIMEOUT) {
+            bool result = sim808_wait_for_resp(resp, type, timeout, charTimeout);
+            TraceRaw('?', resp, result);
+            return result;
+        }
+};
+
+static_assert(sizeof(SIM808Modem) == sizeof(DFRobot_SIM808), "SIM808Modem must not add data members");
+
 
 //////////////////////////////////////
 // --------- 调用工具实例 --------- //
 //////////////////////////////////////
-extern RFID rfid;                   // 读卡模块底层操作工具实例
-extern DFRobot_SIM808 sim808;       // 通讯定位模块底层操作工具实例
+extern RFID READERS[STATION_SLOT_COUNT];
+                                    // 读卡模块底层操作工具实例（各槽位）
+extern SIM808Modem sim808;          // 通讯定位模块底层操作工具实例
 extern U8GLIB_SH1106_128X64 u8g;    // 显示模块底层操作工具实例
 
 
+//////////////////////////////////////
+// ---------- EEPROM分区 ---------- //
+//////////////////////////////////////
+const int EEPROM_ADDR_CARD_CACHE = 0;       // 授权卡片缓存（131 byte）
+const int EEPROM_ADDR_RENT_JOURNAL = 131;   // 借还状态日志（143 byte / 槽位 最多8槽位 每槽位预留144 byte）
+const int EEPROM_ADDR_RUNTIME_CONFIG = 1283;// 运行参数（25 byte）
+const int EEPROM_ADDR_REQUEST_ID = 1308;    // 请求编号预留上限（5 byte / 槽位 最多8槽位）
+
+
 //////////////////////////////////////
 // --------- 工具状态定义 --------- //
 //////////////////////////////////////
@@ -76,10 +212,12 @@ enum CARD_MSG {
 enum REQUEST_MSG {
     REQUEST_NULL                    = 0,    // 无信息
     REQUEST_RENT                    = 10,   // 请求借车
+    REQUEST_REJECT_REPORT           = 11,   // 报告：已开锁但借车被拒绝
     REQUEST_RETURN                  = 20,   // 请求还车
     REQUEST_LOCATION                = 30,   // 发送定位信息
     REQUEST_LOCATION_FAIL           = 31,   // 发送定位失败
     REQUEST_LOWBATTERY              = 40,   // 发送低电量信息
+    REQUEST_PROFILE                 = 50,   // 发送耗时统计信息
 };
 
 // 通讯信息层回复编码
@@ -92,6 +230,7 @@ enum RESPONSE_MSG {
     RENT_FAIL_NEGATIVE_BALANCE      = 122,  // 借车失败：用户欠费
     RENT_FAIL_BIKE_OCCUPIED         = 130,  // 借车失败：车辆被其他用户占用
     RENT_FAIL_BIKE_UNAVAILABLE      = 131,  // 借车失败：车辆故障
+    REJECT_REPORT_SUCCESS           = 140,  // 借车被拒绝报告发送成功
     RETURN_SUCCESS                  = 210,  // 还车成功
     RETURN_FAIL_USER_NOT_MATCH      = 220,  // 还车失败：用户信息冲突
     RETURN_FAIL_ORDER_NONEXISTENT   = 230,  // 还车失败：车辆未借出
@@ -100,6 +239,7 @@ enum RESPONSE_MSG {
     LOCATION_FAIL                   = 330,  // 定位信息发送失败
     LOWBATTERY_SUCCESS              = 410,  // 低电量信息发送成功
     LOWBATTERY_FAIL                 = 420,  // 低电量信息发送失败：预留
+    PROFILE_SUCCESS                 = 510,  // 耗时统计信息发送成功
     ERROR_OTHER                     = 100,  // 错误：服务器其它错误
     // 通讯及解码层
     ERROR_STATUS                    = 900,  // 请求状态错误
@@ -108,58 +248,532 @@ enum RESPONSE_MSG {
     ERROR_DECODE                    = 930,  // 回复信息解码错误
 };
 
+// 通讯模块交互阶段
+enum COM_STAGE {
+    STAGE_SAPBR_3_1,                // 设置承载参数
+    STAGE_SAPBR_1_1,                // 打开承载
+    STAGE_HTTPINIT,                 // 初始化HTTP功能
+    STAGE_HTTPPARA_CID,             // 设置承载编号
+    STAGE_HTTPPARA_URL,             // 设置请求URL
+    STAGE_HTTPACTION,               // 发送请求
+    STAGE_HTTPREAD,                 // 读取回复
+    STAGE_HTTPTERM,                 // 关闭HTTP功能
+    STAGE_SAPBR_0_1,                // 关闭承载
+    STAGE_GPS_ATTACH,               // 打开GPS
+    STAGE_GPS_READ,                 // 获取GPS数据
+    STAGE_GPS_DETACH,               // 关闭GPS
+    STAGE_REQUEST,                  // 完整请求
+    STAGE_CIICR,                    // 打开移动场景（TCP方式）
+    STAGE_CIPSTART,                 // 建立TCP连接
+    STAGE_CIPSEND,                  // 发送请求报文
+    STAGE_CIPRECV,                  // 接收回复报文
+    STAGE_CIPCLOSE,                 // 关闭TCP连接
+    STAGE_UDP_START,                // 建立UDP遥测连接
+    STAGE_UDP_SEND,                 // 发送遥测数据报
+};
+
+// 耗时统计的通讯阶段（仅包括所选通讯方式用到的阶段 依次占用 PHASE_COM_STAGE 起的统计位置）
+constexpr COM_STAGE PROFILED_STAGES[] = {
+#if COM_TRANSPORT != COM_TRANSPORT_TCP
+    STAGE_SAPBR_3_1, STAGE_SAPBR_1_1, STAGE_HTTPINIT, STAGE_HTTPPARA_CID, STAGE_HTTPPARA_URL,
+    STAGE_HTTPACTION, STAGE_HTTPREAD, STAGE_HTTPTERM, STAGE_SAPBR_0_1,
+#endif
+    STAGE_GPS_ATTACH, STAGE_GPS_READ, STAGE_GPS_DETACH, STAGE_REQUEST,
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+    STAGE_CIICR, STAGE_CIPSTART, STAGE_CIPSEND, STAGE_CIPRECV, STAGE_CIPCLOSE,
+#elif TELEMETRY_UDP
+    STAGE_CIICR,
+#endif
+#if TELEMETRY_UDP
+    STAGE_UDP_START, STAGE_UDP_SEND,
+#endif
+};
+
+// 耗时统计阶段
+enum PROFILE_PHASE {
+    PHASE_BATTERY,                  // 读取电量
+    PHASE_NEED_UPDATE,              // 检查是否需要定位
+    PHASE_DO_UPDATE,                // 定位
+    PHASE_SEARCH_CARD,              // 寻卡
+    PHASE_DISPLAY_WAIT,             // 显示等待信息
+    PHASE_DISPLAY_CLEAR,            // 清空显示信息
+    PHASE_DISPLAY_COM,              // 显示通讯信息
+    PHASE_DISPLAY_DETAILS,          // 显示详细信息
+    PHASE_DISPLAY_CARD,             // 显示读卡信息
+    PHASE_UNLOCK,                   // 开锁
+    PHASE_LOOP_TERM,                // 循环终止操作
+    PHASE_COM_STAGE,                // 通讯阶段起始（依次对应PROFILED_STAGES 上传编码为 PHASE_COM_STAGE + COM_STAGE）
+    PHASE_COUNT = PHASE_COM_STAGE + sizeof(PROFILED_STAGES) / sizeof(PROFILED_STAGES[0]),
+};
+
+// 通讯阶段统计范围（所选通讯方式的各交互阶段 随定位信息上传 不计入耗时统计记录）
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+const COM_STAGE STAGE_STATS_FIRST = STAGE_CIICR;
+const COM_STAGE STAGE_STATS_LAST = STAGE_CIPCLOSE;
+#else
+const COM_STAGE STAGE_STATS_FIRST = STAGE_SAPBR_3_1;
+const COM_STAGE STAGE_STATS_LAST = STAGE_SAPBR_0_1;
+#endif
+
+// 重试类型（各自独立的重试预算）
+enum RETRY_TYPE {
+    RETRY_RETURN,                   // 还车
+    RETRY_LOWBATTERY,               // 低电量
+    RETRY_TYPE_COUNT,
+};
+
+// 启动阶段（依次完成）
+enum BOOT_STAGE {
+    BOOT_RESTORE,                   // 恢复借还状态
+    BOOT_RFID,                      // 读卡模块就绪
+    BOOT_DISPLAY,                   // 显示模块就绪
+    BOOT_LOCK,                      // 车锁就绪（可本地授权借车）
+    BOOT_MODEM,                     // 通讯模块响应
+    BOOT_NETWORK,                   // 网络注册完成（可联网借车）
+    BOOT_STAGE_COUNT,
+};
+
+// 定时器编号（固定槽位）
+enum TIMER_ID {
+    TIMER_LOCATION,                 // 定位间隔
+    TIMER_DISPLAY,                  // 显示停留
+    TIMER_LOCK,                     // 开锁保持
+    TIMER_RETRY,                    // 重试冷却起始（依次对应RETRY_TYPE）
+    TIMER_COUNT = TIMER_RETRY + RETRY_TYPE_COUNT,
+};
+
+// 运行参数（服务器下发 依次对应下发格式中各字段）
+enum CONFIG_PARAM {
+    CONFIG_UPDATE_RENT,             // 定位间隔：已借用（s）
+    CONFIG_UPDATE_NOT_RENT,         // 定位间隔：未借用（s）
+    CONFIG_UPDATE_NOT_AVAILABLE,    // 定位间隔：不可用（s）
+    CONFIG_GPS_OVERTIME,            // 定位时限（ms）
+    CONFIG_INTERVAL_SHORT,          // 通讯指令短间隔（ms）
+    CONFIG_INTERVAL_LONG,           // 通讯指令长间隔（ms）
+    CONFIG_CARD_MIN_READING,        // 确认卡片需超过的连续读卡次数
+    CONFIG_CARD_MIN_DETATCH,        // 确认取走需超过的连续未读次数
+    CONFIG_DISPLAY_WAIT,            // 等待信息停留（ms）
+    CONFIG_DISPLAY,                 // 通讯信息停留（ms）
+    CONFIG_DISPLAY_LONG,            // 详细信息停留（ms）
+    CONFIG_PARAM_COUNT,
+};
+
 
 //////////////////////////////////////
 // ----------- 工具定义 ----------- //
 //////////////////////////////////////
+/**
+ * 定时器工具
+ * 64位运行时间（含休眠时间 不会溢出）+ 固定槽位定时器（注册及检查均为O(1)）
+ * 阻塞等待期间按固定间隔调用等待钩子（车桩模式下为其余槽位寻卡）
+ * 使用流程：开始计时 -> 检查是否到期 / 剩余时间 / 已过时间 -> 取消
+ *           start      expired / remaining / elapsed          cancel
+ */
+class Timer {
+    public:
+        Timer();
+
+        unsigned long long uptime();
+
+        void start(const TIMER_ID id, const unsigned long duration);
+        void cancel(const TIMER_ID id);
+        void wait(const TIMER_ID id);
+        void hold(const unsigned long duration);
+
+        void setWaitHook(void (*hook)());
+
+        bool isActive(const TIMER_ID id);
+        bool expired(const TIMER_ID id);
+        unsigned long remaining(const TIMER_ID id);
+        unsigned long elapsed(const TIMER_ID id);
+
+    private:
+        // 阻塞等待时调用等待钩子的间隔
+        const unsigned long HOOK_INTERVAL = 50;     // ms
+
+        unsigned long long _uptimeHigh;
+        unsigned long _lastTime;
+        void (*_waitHook)();
+
+        unsigned long long _start[TIMER_COUNT];
+        unsigned long _duration[TIMER_COUNT];
+        bool _active[TIMER_COUNT];
+};
+
+
 /**
  * 车辆借还状态工具
+ * 每次状态改变写入EEPROM日志（循环写入各日志槽位以均衡磨损） 重启后立即恢复
+ * 使用流程：绑定车桩槽位 -> 启动时恢复 -> 改变状态（借车时附带卡片序列号）-> 获取状态
+ *           attach          restore       changeState                         getState / getCardSerial
  */
 class RentState {
     public:
         RentState(RENT_STATE rentState = NOT_RENT);
 
+        void attach(const int slot);
+
         void changeState(const RENT_STATE newState);
+        void changeState(const RENT_STATE newState, const unsigned long cardSerial, const bool pending = false, const unsigned long requestID = 0);
         RENT_STATE getState();
 
         bool isAvailable();
 
+        unsigned long getCardSerial();
+        unsigned long getRequestID();
+        void setPending(const bool pending);
+        bool isPending();
+
+        bool restore();
+
     private:
         RENT_STATE _rentState;
+        unsigned long _cardSerial;
+        unsigned long _requestID;
+        bool _pending;
+
+        // 日志记录：序号 状态 标志 卡片序列号 借车请求编号 校验
+        struct Record {
+            unsigned int seq;
+            unsigned char state;
+            unsigned char flags;
+            unsigned long cardSerial;
+            unsigned long requestID;
+            unsigned char check;
+        };
+
+        static const unsigned char FLAG_PENDING = 0x01;
+
+        // 日志槽位数（每槽位 sizeof(Record) byte 分区大小不变）
+        static const int JOURNAL_SLOTS = 11;
+
+        int _journalAddr;
+        int _nextSlot;
+        unsigned int _nextSeq;
+
+        // 上次写入的记录（内容未变时不再写入）
+        Record _last;
+
+        void journal();
+        unsigned char checksum(const Record &record);
+};
+
+
+/**
+ * 读卡防抖状态转移（编译期转移表项）
+ */
+enum CARD_COUNTER_OP {
+    COUNTER_KEEP,                   // 计数器不变
+    COUNTER_ADD,                    // 计数器加值
+    COUNTER_ONE,                    // 计数器清零后加值
+};
+
+enum CARD_CHECK {
+    CHECK_NONE,                     // 直接转移
+    CHECK_CONFIRM,                  // 读卡次数超过阈值时确认卡片
+    CHECK_CHANGED,                  // 卡片改变时重新读取
+    CHECK_DETATCH,                  // 未读次数超过阈值时确认取走
+};
+
+struct CardTransition {
+    CARD_STATE next;                // 转移后状态（检查未通过时保持原状态）
+    CARD_COUNTER_OP counter;        // 计数器操作
+    CARD_CHECK check;               // 附加检查
+    CARD_MSG msg;                   // 读卡消息（检查未通过时为NOTHING）
+};
+
+// 转移表：[是否读到卡片][当前读卡状态]（存放于Flash 按项读取 不占用SRAM）
+const CardTransition CARD_TRANSITIONS[2][4] PROGMEM = {
+    {   // 未读到卡片
+        { CARD_NOT_FOUND,   COUNTER_KEEP,   CHECK_NONE,     NOTHING },              // CARD_NOT_FOUND
+        { CARD_DETATCHING,  COUNTER_ONE,    CHECK_NONE,     CARD_DETATCHED },       // CARD_READING
+        { CARD_DETATCHING,  COUNTER_ADD,    CHECK_NONE,     CARD_DETATCHED },       // CARD_FOUND
+        { CARD_DETATCHING,  COUNTER_ADD,    CHECK_DETATCH,  NOTHING },              // CARD_DETATCHING
+    },
+    {   // 读到卡片
+        { CARD_READING,     COUNTER_ADD,    CHECK_NONE,     NEW_CARD_DETECTED },    // CARD_NOT_FOUND
+        { CARD_READING,     COUNTER_ADD,    CHECK_CONFIRM,  NOTHING },              // CARD_READING
+        { CARD_FOUND,       COUNTER_KEEP,   CHECK_CHANGED,  NOTHING },              // CARD_FOUND
+        { CARD_READING,     COUNTER_ONE,    CHECK_NONE,     NEW_CARD_DETECTED },    // CARD_DETATCHING
+    },
+};
+
+
+/**
+ * 读卡防抖状态机
+ * MIN_READING  - 确认卡片需超过的连续读卡次数（默认值 可运行时调整）
+ * MIN_DETATCH  - 确认取走需超过的连续未读次数（默认值 可运行时调整）
+ * 使用流程：每次寻卡后 -> 推进状态机 -> 依照消息操作
+ *                         step
+ */
+template <int MIN_READING, int MIN_DETATCH>
+class CardDebounce {
+    static_assert(MIN_READING > 0 && MIN_DETATCH > 0, "Card debounce thresholds must be positive");
+
+    public:
+        CardDebounce();
+
+        CARD_MSG step(const bool present, const unsigned long serial);
+        unsigned long getSerNum();
+        bool isActive();
+
+        void restore(const unsigned long serial);
+        void reset();
+
+        void setThresholds(const int minReading, const int minDetatch);
+
+    private:
+        unsigned long _cardSerNum;
+        CARD_STATE _cardState;
+        int _cardCounter;
+
+        int _minReading;
+        int _minDetatch;
 };
 
+/**
+ * 读卡防抖状态机构造函数
+ */
+template <int MIN_READING, int MIN_DETATCH>
+CardDebounce<MIN_READING, MIN_DETATCH>::CardDebounce() {
+    _minReading = MIN_READING;
+    _minDetatch = MIN_DETATCH;
+    reset();
+}
+
+/**
+ * 按转移表推进状态机
+ * @param  present 是否读到卡片（车辆可用时）
+ * @param  serial  读到的卡片序列号
+ * @return         读卡消息
+ */
+template <int MIN_READING, int MIN_DETATCH>
+CARD_MSG CardDebounce<MIN_READING, MIN_DETATCH>::step(const bool present, const unsigned long serial) {
+    CardTransition transition;
+    memcpy_P(&transition, &CARD_TRANSITIONS[present ? 1 : 0][_cardState], sizeof(transition));
+
+    // 计数器操作
+    if (transition.counter == COUNTER_ADD) {
+        _cardCounter++;
+    } else if (transition.counter == COUNTER_ONE) {
+        _cardCounter = 1;
+    }
+
+    switch (transition.check) {
+        case CHECK_CONFIRM:
+            if (_cardCounter > _minReading) {
+                _cardCounter = 0;
+                _cardState = CARD_FOUND;
+                if (_cardSerNum != serial) {
+                    // 发现新卡
+                    _cardSerNum = serial;
+                    return NEW_CARD_CONFIRMED;
+                }
+                // 同一张卡
+                return SAME_CARD_AGAIN;
+            }
+        return NOTHING;
+        case CHECK_CHANGED:
+            if (_cardSerNum != serial) {
+                _cardCounter = 0;
+                _cardState = CARD_READING;
+                _cardSerNum = serial;
+                return ERROR_DIFFERENT_CARD;
+            }
+        return NOTHING;
+        case CHECK_DETATCH:
+            if (_cardCounter > _minDetatch) {
+                // 之前是否存在卡片
+                CARD_MSG msg = (_cardSerNum != 0) ? CARD_DETATCH_CONFIRMED : CARD_READ_STOP;
+                reset();
+                return msg;
+            }
+        return NOTHING;
+        default:
+        break;
+    }
+
+    _cardState = transition.next;
+    return transition.msg;
+}
+
+/**
+ * 获取已确认卡片序列号
+ * @return 卡片序列号
+ */
+template <int MIN_READING, int MIN_DETATCH>
+unsigned long CardDebounce<MIN_READING, MIN_DETATCH>::getSerNum() {
+    return _cardSerNum;
+}
+
+/**
+ * 检查是否处于读卡或取走过程中（需快速寻卡）
+ * @return true - 读卡中 / 取走中; false - 无卡片 / 已发现卡片
+ */
+template <int MIN_READING, int MIN_DETATCH>
+bool CardDebounce<MIN_READING, MIN_DETATCH>::isActive() {
+    return (_cardState == CARD_READING) || (_cardState == CARD_DETATCHING);
+}
+
+/**
+ * 恢复为已发现卡片（重启后恢复借车状态时使用）
+ * @param serial 卡片序列号
+ */
+template <int MIN_READING, int MIN_DETATCH>
+void CardDebounce<MIN_READING, MIN_DETATCH>::restore(const unsigned long serial) {
+    _cardSerNum = serial;
+    _cardState = CARD_FOUND;
+    _cardCounter = 0;
+}
+
+/**
+ * 重置状态机
+ */
+template <int MIN_READING, int MIN_DETATCH>
+void CardDebounce<MIN_READING, MIN_DETATCH>::reset() {
+    _cardSerNum = 0;
+    _cardState = CARD_NOT_FOUND;
+    _cardCounter = 0;
+}
+
+/**
+ * 调整防抖阈值（非正值时保持原值 进行中的计数不受影响）
+ * @param minReading 确认卡片需超过的连续读卡次数
+ * @param minDetatch 确认取走需超过的连续未读次数
+ */
+template <int MIN_READING, int MIN_DETATCH>
+void CardDebounce<MIN_READING, MIN_DETATCH>::setThresholds(const int minReading, const int minDetatch) {
+    if (minReading > 0) {
+        _minReading = minReading;
+    }
+    if (minDetatch > 0) {
+        _minDetatch = minDetatch;
+    }
+}
+
 
 /**
  * 读卡工具
  * 使用流程：寻卡       -> 依照状态：获取序列号 / 其他操作
  *           searchCard -> getSerNum / [OTHER OPERATION]
+ *           循环终止时：空闲则读卡模块掉电 -> 按寻卡间隔等待
+ *                       standby               getPollInterval
+ * 防抖阈值默认值可在编译时通过 CARD_MIN_READING / CARD_MIN_DETATCH 按部署配置 运行时由运行参数调整
+ * READER - 读卡模块驱动类型（设备上为RFID 主机测试时可替换为模拟驱动）
  */
-class Card {
+#ifndef CARD_MIN_READING
+#define CARD_MIN_READING 3
+#endif
+#ifndef CARD_MIN_DETATCH
+#define CARD_MIN_DETATCH 11     // 取走中按 POLL_INTERVAL_ACTIVE 寻卡 确认取走约需1.2s（骑行中卡片晃动不致还车）
+#endif
+
+template <class READER>
+class CardT {
 
     public:
-        Card();
+        CardT();
+
+        void attach(READER* reader);
 
         CARD_MSG searchCard(RENT_STATE state);
         unsigned long getSerNum();
 
+        unsigned long getPollInterval();
+        void standby();
+
+        void restore(const unsigned long cardSerial);
         void reset();
 
     private:
+        // 寻卡间隔
+        const unsigned long POLL_INTERVAL_ACTIVE = 100;     // ms 读卡中 / 取走中
+        const unsigned long POLL_INTERVAL_IDLE = 200;       // ms 无卡片 / 已发现卡片
+        const unsigned long POLL_INTERVAL_DORMANT = 500;    // ms 长时间无读卡活动
+        const unsigned long DORMANT_AFTER = 60000;          // ms
+
+        // RC522寄存器及指令
+        static const unsigned char RC_COMMAND_REG = 0x01;
+        static const unsigned char RC_POWER_DOWN = 0x10;
+        static const unsigned char RC_CMD_IDLE = 0x00;
+        static const int RC_WAKE_RETRY = 10;
+
+        READER* _reader;
+        unsigned long _lastActivity;
+        bool _readerDown;
+
+        void wakeReader();
+
+        // 读卡防抖状态机
+        CardDebounce<CARD_MIN_READING, CARD_MIN_DETATCH> _debounce;
+};
 
-        // 满足操作条件最低读卡次数
-        const int MIN_CARD_READING = 3;
-        const int MIN_CARD_DETATCH = 5;
+typedef CardT<RFID> Card;
 
-        unsigned long cardSerNum;
-        CARD_STATE _cardState;
-        int _cardCounter;
 
-        void changeState(const CARD_STATE newState);
-        CARD_STATE getState();
+/**
+ * 本地授权卡片缓存工具
+ * 由服务器随定位回复下发（按序列号升序） 保存在EEPROM中 断网时亦可授权借车
+ * 使用流程：借车时查询 -> 已授权：立即开锁 稍后补发借车请求
+ *           contains      true
+ *                      -> 未授权：正常借车流程
+ *                         false
+ *           定位回复包含新版本 -> 保存
+ *                                 store
+ */
+class CardCache {
+    public:
+        CardCache();
 
-        inline int getCounter();
-        inline void addCounter();
-        inline void clearCounter();
+        bool contains(const unsigned long cardSerial);
+        bool store(const unsigned int version, const char* cards);
+
+        unsigned int getVersion();
+        unsigned char getCount();
+
+        // 最大缓存卡片数
+        static const unsigned char CAPACITY = 32;
+
+        // 单张卡片序列号长度（十六进制字符）
+        static const int SERIAL_HEX_LENGTH = 8;
+
+    private:
+        // EEPROM内布局：版本号 卡片数 序列号数组
+        static const int ADDR_VERSION = EEPROM_ADDR_CARD_CACHE;
+        static const int ADDR_COUNT = ADDR_VERSION + sizeof(unsigned int);
+        static const int ADDR_CARDS = ADDR_COUNT + sizeof(unsigned char);
+
+        unsigned long readCard(const unsigned char index);
+        bool parseCard(const char* hex, unsigned long &card);
+};
+
+
+/**
+ * 卡片借车记录工具（仅保存在内存中 重启后重新积累）
+ * 近期连续借车成功的卡片可乐观开锁 借车请求在开锁后确认
+ * 使用流程：借车前查询 -> 借车成功：记录成功 / 借车被拒绝：记录失败
+ *           isTrusted     recordSuccess      recordFail
+ */
+class CardHistory {
+    public:
+        CardHistory();
+
+        bool isTrusted(const unsigned long cardSerial);
+        void recordSuccess(const unsigned long cardSerial);
+        void recordFail(const unsigned long cardSerial);
+
+    private:
+        // 记录卡片数
+        static const int CAPACITY = 8;
+
+        // 可乐观开锁的最少连续成功次数
+        static const unsigned char TRUST_THRESHOLD = 3;
+
+        unsigned long _cards[CAPACITY];
+        unsigned char _successes[CAPACITY];
+        int _next;
+
+        int find(const unsigned long cardSerial);
 };
 
 
@@ -171,13 +785,17 @@ class Card {
  *                                             false
  *                        -> 不需要：无操作
  *                           false
+ * MODEM / modem - 通讯定位模块驱动类型及实例（编译时绑定 直接调用无虚函数开销）
  */
-class LocationUpdate {
+template <class MODEM, MODEM &modem>
+class LocationUpdateT {
     public:
-        LocationUpdate();
+        LocationUpdateT();
 
         unsigned long getLastUpdate();
         bool needUpdate(const RENT_STATE state);
+        unsigned long getTimeToUpdate(const RENT_STATE state);
+        void requestUpdate();
         void pauseUpdate();
         void resumeUpdate();
         bool doUpdate();
@@ -195,24 +813,132 @@ class LocationUpdate {
         const unsigned long INTERVAL_SHORT = 200;
         const unsigned long INTERVAL_LONG = 1000;
 
-        // 定位时限
-        const unsigned long UPDATE_INTERVAL_RENT_IN_MIN = 1;            // min
-        const unsigned long UPDATE_INTERVAL_NOT_RENT_IN_MIN = 10;       // min
-        const unsigned long UPDATE_INTERVAL_NOT_AVAILABLE_IN_MIN = 5;   // min
-
-        const unsigned long UPDATE_INTERVAL_RENT = UPDATE_INTERVAL_RENT_IN_MIN * 60 * 1000;                     // ms
-        const unsigned long UPDATE_INTERVAL_NOT_RENT = UPDATE_INTERVAL_NOT_RENT_IN_MIN * 60 * 1000;             // ms
-        const unsigned long UPDATE_INTERVAL_NOT_AVAILABLE = UPDATE_INTERVAL_NOT_AVAILABLE_IN_MIN * 60 * 1000;   // ms
+        // 定位间隔及定位时限见运行参数（CONFIG_UPDATE_* / CONFIG_GPS_OVERTIME）
 
-        const unsigned long GPS_OVERTIME = 30000;   // ms
-
-        unsigned long _lastUpdate;
         bool _updatePaused;
+        bool _updateRequested;      // 立即定位（服务器唤醒 不受定位间隔限制）
         
         // 定位信息 默认值：1000
         float _latitude;
         float _longitude;
 
+        unsigned long getInterval(const RENT_STATE state);
+};
+
+typedef LocationUpdateT<SIM808Modem, sim808> LocationUpdate;
+
+
+/**
+ * 耗时分布统计工具
+ * 按4的幂次分桶（单位：us） 内存占用固定（32B）
+ * 桶0：< 1024us; 桶k：[2^(8+2k), 2^(10+2k)) us; 最后一桶：>= 2^22 us（约4.2s）
+ */
+class Histogram {
+    public:
+        Histogram();
+
+        void add(const unsigned long duration);
+
+        unsigned int getCount();
+        unsigned long getTotal();
+        unsigned long getMin();
+        unsigned long getMax();
+        unsigned long getAverage();
+        unsigned long getPercentile(const int percent);
+
+        String toString();
+
+        void reset();
+
+    private:
+        static const int BUCKET_COUNT = 8;
+        static const int BUCKET_SHIFT = 10;
+        static const int BUCKET_WIDTH = 2;      // 相邻桶上界相差 2^BUCKET_WIDTH 倍
+
+        unsigned int _buckets[BUCKET_COUNT];
+        unsigned int _count;
+        unsigned long _total;           // ms
+        unsigned int _totalRemainder;   // us（不足1ms部分）
+        unsigned long _min;             // us
+        unsigned long _max;             // us
+};
+
+
+/**
+ * 单次请求临时内存工具
+ * 顺序分配 每次请求开始时整体释放 避免请求间反复分配释放造成堆碎片
+ * 使用流程：请求开始时重置 -> 解码时分配 -> 至下次请求前保持有效
+ *           reset             alloc / copy / append
+ */
+class RequestArena {
+    public:
+        RequestArena();
+
+        char* alloc(const unsigned int size);
+        char* copy(const char* str, const unsigned int length);
+        bool append(const char* str, const unsigned int length);
+
+        unsigned int getUsed();
+        unsigned int getHighWater();
+
+        void reset();
+
+    private:
+        // 最长回复：同时带授权卡片缓存及运行参数的定位回复（紧凑JSON 各版本号最多5位 各参数最多5位以'.'分隔）
+        // {"state":320,"cacheVersion":65535,"cards":"...","configVersion":65535,"config":"..."}
+        static const unsigned int RESPONSE_FRAME_LENGTH = 79;   // 不含卡片及参数内容
+        static const unsigned int RESPONSE_MAX_LENGTH = RESPONSE_FRAME_LENGTH
+            + CardCache::CAPACITY * CardCache::SERIAL_HEX_LENGTH
+            + CONFIG_PARAM_COUNT * 6 - 1;
+
+        // 最长回复及结束符 另留少量余量
+        static const unsigned int ARENA_SIZE = 416;
+        static_assert(ARENA_SIZE >= RESPONSE_MAX_LENGTH + 1, "Request arena cannot hold the longest response");
+
+        char _buffer[ARENA_SIZE];
+        unsigned int _used;
+        unsigned int _highWater;
+};
+
+
+struct RetryBudget {
+    int maxAttempts;                // 每轮最多尝试次数（含首次）
+    unsigned long baseDelay;        // 首次退避时间（ms 此后逐次加倍）
+    unsigned long maxDelay;         // 单次退避上限（ms）
+    unsigned long maxBlocking;      // 每轮累计阻塞上限（ms 自开始起计 含各次请求耗时及退避等待）
+    unsigned long cooldown;         // 用尽后再次允许重试的冷却时间（ms）
+};
+
+// 预算表：[重试类型]
+constexpr RetryBudget RETRY_BUDGETS[RETRY_TYPE_COUNT] = {
+    { 6,    1000,   8000,   30000,  0 },        // RETRY_RETURN
+    { 4,    2000,   16000,  30000,  600000 },   // RETRY_LOWBATTERY
+};
+
+/**
+ * 重试策略工具
+ * 指数退避 + 随机抖动（避免全部车辆同时重试）
+ * 使用流程：开始新一轮 -> 每次尝试前检查（首次不等待 此后退避等待）
+ *           begin         next
+ */
+class RetryPolicy {
+    public:
+        RetryPolicy();
+
+        void begin(const RetryBudget &budget, const TIMER_ID timer);
+        bool next();
+
+        int getAttempt();
+
+        // 退避及预算判断（无状态 供车队恢复模拟复用）
+        static unsigned long backoff(const RetryBudget &budget, const int attempt, const bool jitter = true);
+        static bool withinBudget(const RetryBudget &budget, const int attempt, const unsigned long blocked, const unsigned long wait);
+
+    private:
+        const RetryBudget* _budget;
+        TIMER_ID _timer;
+        int _attempt;
+        unsigned long _beginAt;     // 本轮开始时间（累计阻塞含各次请求耗时）
 };
 
 
@@ -224,47 +950,90 @@ class LocationUpdate {
  *                         false: getError    -> resetResponse
  * 通讯及解码层：本地通讯模块及信息解码
  * 信息层：服务器回复信息意图
+ * MODEM / modem - 通讯定位模块驱动类型及实例（编译时绑定 直接调用无虚函数开销）
+ * 通讯方式由 COM_TRANSPORT 编译时选择 接口不变
  */
-class HTTPCom {
+template <class MODEM, MODEM &modem>
+class HTTPComT {
+    friend void runBenchmark();
+
     public:
-        HTTPCom();
+        HTTPComT();
 
-        bool requestRent(const int bikeID, const unsigned long cardSerial);
-        bool requestReturn(const int bikeID, const unsigned long cardSerial);
+        bool requestRent(const int bikeID, const unsigned long cardSerial, const unsigned long requestID);
+        bool requestReturn(const int bikeID, const unsigned long cardSerial, const unsigned long requestID);
+        bool requestRejectReport(const int bikeID, const unsigned long cardSerial);
         bool requestLocation(const int bikeID, const float longitude, const float latitude, const float batteryLevel);
         bool requestLocationFail(const int bikeID, const float batteryLevel);
         bool requestLowBattery(const int bikeID, const float batteryLevel);
+        bool requestProfile(const int bikeID, const String &profile, const String &boot = "");
 
         bool hasResponse();
+        bool isDuplicate();
 
         RESPONSE_MSG getResponse();
         RESPONSE_MSG getError();
         
-        String getResponse_UserID();
-        String getResponse_Balance();
-        String getResponse_Duration();
+        const char* getResponse_UserID();
+        const char* getResponse_Balance();
+        const char* getResponse_Duration();
+        unsigned long getResponse_CardSerial();
 
         void resetResponse();
 
+        bool prepare();
+        void cancelPrepare();
+
+        void beginRetry(const RETRY_TYPE type);
+        bool retry(const RETRY_TYPE type);
+
+#if TELEMETRY_UDP
+        bool sendLocation(const int slot, const int bikeID, const float longitude, const float latitude, const float batteryLevel);
+        bool sendLocationFail(const int slot, const int bikeID, const float batteryLevel);
+        bool sendLowBattery(const int slot, const int bikeID, const float batteryLevel);
+
+        void pollTelemetry();
+
+        bool hasAvailability(const int slot);
+        RESPONSE_MSG getAvailability(const int slot);
+
+        int getUnacked();
+        bool isTelemetryStalled();
+        bool isListening();
+        bool needSync();
+#endif
+
     private:
         RESPONSE_MSG _state;
-        String _userID;
-        String _balance;
-        String _duration;
+        const char* _userID;
+        const char* _balance;
+        const char* _duration;
+        unsigned long _cardSerial;
         String _request;
 
-        // 指令间间隔时间
-        const unsigned long INTERVAL_SHORT = 200;
-        const unsigned long INTERVAL_LONG = 1000;
+        // 指令间间隔时间见运行参数（CONFIG_INTERVAL_SHORT / CONFIG_INTERVAL_LONG）
+
+        // 请求指令预留长度
+        const unsigned int REQUEST_BUFFER_SIZE = 160;
+
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+        // GET报文头尾（保持连接）
+        const String REQUEST_CMD_HEADER = "GET /test.php";
+        const String REQUEST_CMD_ENDER = " HTTP/1.1\r\nHost: 52.197.101.234\r\nConnection: keep-alive\r\n\r\n";
 
+        // 建立连接指令（连接编号0）
+        const char* CMD_CIPSTART = "AT+CIPSTART=0,\"TCP\",\"52.197.101.234\",80\r\n";
+#else
         // GET指令头尾（包括访问URL）
         const String REQUEST_CMD_HEADER = "AT+HTTPPARA=\"URL\",\"http://52.197.101.234/test.php";
         const String REQUEST_CMD_ENDER = "\"\r\n";
+#endif
 
         // 通讯操作关键字
         const String REQUEST_CMD_RENT_RETURN = "?get1=";
         const String REQUEST_CMD_LOCATION = "?get2=";
         const String REQUEST_CMD_BATTERY = "?get3=";
+        const String REQUEST_CMD_PROFILE = "?get4=";
 
         // 通讯接口变量关键字
         const char* KEY_STATE = "state";
@@ -276,35 +1045,186 @@ class HTTPCom {
         const char* KEY_BATTERYLEVEL = "batteryLevel";
         const char* KEY_LONGITUDE = "longitude";
         const char* KEY_LATITUDE = "latitude";
+        const char* KEY_PROFILE = "profile";
+        const char* KEY_BOOT = "boot";
+        const char* KEY_COM_STATS = "comStats";
+        const char* KEY_CACHE_VERSION = "cacheVersion";
+        const char* KEY_CARDS = "cards";
+        const char* KEY_CONFIG_VERSION = "configVersion";
+        const char* KEY_CONFIG = "config";
+        const char* KEY_REQUEST_ID = "requestID";
+        const char* KEY_DUPLICATE = "duplicate";
 
         bool _hasResponse;
 
+        // 进行中请求的编号（0 - 无编号）及回复是否为服务器重放的重复确认
+        unsigned long _requestID;
+        bool _duplicate;
+
+        // 预先打开的承载有效时间
+        const unsigned long PREPARE_TIMEOUT = 60000;    // ms
+
+        bool _prepared;
+        unsigned long _preparedAt;
+
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+        // 连接空闲保持时间（超过后服务器可能已关闭连接 请求前主动重连）
+        const unsigned long KEEPALIVE_TIMEOUT = 10000;  // ms
+
+        // 建立连接及发送超时
+        const unsigned int CONNECT_TIMEOUT = 10;        // s
+        const unsigned int SEND_TIMEOUT = 5;            // s
+
+        // 回复报文读取（首字节等待 / 字符间隔 / 分块大小）
+        const unsigned int RECV_TIMEOUT = 5;            // s
+        const unsigned int RECV_CHAR_TIMEOUT = 200;     // ms
+        static const unsigned int RECV_CHUNK_SIZE = 64;
+
+        bool _connected;            // TCP连接已建立
+        unsigned long _lastActive;  // 连接最近收发时间
+#endif
+
+#if COM_TRANSPORT == COM_TRANSPORT_TCP || TELEMETRY_UDP
+        bool _contextOpen;          // 移动场景已打开（TCP连接及UDP遥测共用）
+#endif
+
+#if TELEMETRY_UDP
+        // 遥测记录（确认前保留）
+        struct TelemetryRecord {
+            unsigned int seq;       // 序号（递增 溢出后回绕）
+            REQUEST_MSG type;       // 请求码（定位 / 定位失败 / 低电量）
+            unsigned char slot;     // 槽位（确认中的车辆可用状态依此分发）
+            int bikeID;
+            float longitude;
+            float latitude;
+            float batteryLevel;
+        };
+
+        // 建立UDP连接指令（连接编号1）
+        const char* CMD_UDP_START = "AT+CIPSTART=1,\"UDP\",\"52.197.101.234\",9000\r\n";
+
+        // 遥测关键字（数据报 seq / 确认 ack）
+        const char* KEY_SEQ = "seq";
+        const char* KEY_ACK = "ack";
+
+        // 确认数据报读取（单次最大长度 / 字符间隔）
+        static const unsigned int ACK_BUFFER_SIZE = 96;
+        const unsigned int ACK_CHAR_TIMEOUT = 20;       // ms
+
+        TelemetryRecord _unacked[TELEMETRY_UNACKED_MAX];
+        int _unackedCount;
+        unsigned int _nextSeq;
+        bool _udpOpen;
+
+        // 各槽位最近确认的车辆可用状态（读取后清空）
+        RESPONSE_MSG _availability[STATION_SLOT_COUNT];
+
+        // 确认中的服务器卡片缓存及运行参数版本（0 - 尚未收到）
+        unsigned int _serverCacheVersion;
+        unsigned int _serverConfigVersion;
+
+        bool pushTelemetry(const TelemetryRecord &record);
+        void buildTelemetry();
+        void decodeAck(char *json);
+#endif
+
+        // 单次请求临时内存（回复内容及解码结果）
+        RequestArena _arena;
+
+#if COM_TRANSPORT != COM_TRANSPORT_TCP
+        // 回复正文分块读取（AT+HTTPREAD=<起始>,<长度> 每块长度 / 首字节等待 / 字符间隔）
+        static const unsigned int READ_CHUNK_SIZE = 64;
+        const unsigned int READ_TIMEOUT = 5;            // s
+        const unsigned int READ_CHAR_TIMEOUT = 50;      // ms
+
+        // 单块回复各部分最大长度：指令回显（AT+HTTPREAD=65535,64\r\r\n） / 数据提示（\r\n+HTTPREAD: 64\r\n） / 结尾（\r\nOK\r\n）
+        static const unsigned int READ_ECHO_LENGTH = 24;
+        static const unsigned int READ_HEADER_LENGTH = 18;
+        static const unsigned int READ_TRAILER_LENGTH = 6;
+
+        // 单块读取缓冲区（可容纳完整一块回复 另加结尾'\0'）
+        char _readBuffer[READ_ECHO_LENGTH + READ_HEADER_LENGTH + READ_CHUNK_SIZE + READ_TRAILER_LENGTH + 1];
+#endif
+
+        // 回复JSON逐块提取（仅保留最外层对象 按大括号深度判断结束 忽略字符串内括号）
+        char *_json;
+        int _jsonDepth;
+        bool _jsonInString;
+        bool _jsonEscape;
+        bool _jsonOverflow;
+
+        // 本次请求是否附带通讯阶段统计（请求成功后清空已发送的统计）
+        bool _stageStatsSent;
+
+        // 各类型请求重试策略
+        RetryPolicy _retry[RETRY_TYPE_COUNT];
+
+        void buildRent(const int bikeID, const unsigned long cardSerial, const unsigned long requestID);
+        void buildReturn(const int bikeID, const unsigned long cardSerial, const unsigned long requestID);
+        void buildLocation(const int bikeID, const float longitude, const float latitude, const float batteryLevel);
+        void buildLocationFail(const int bikeID, const float batteryLevel);
+        void buildLowBattery(const int bikeID, const float batteryLevel);
+
+        void beginRequest(const String &cmd, const REQUEST_MSG requestCode, const int bikeID);
+        void appendParam(const char* key, const unsigned long value);
+        void appendParam(const char* key, const float value);
+        void appendParam(const char* key, const String &value);
+        void appendStageStats();
+
+        void clearResponse();
+
         bool sendRequest();
-        bool decodeResponse(String response);
+        bool exchange();
+#if COM_TRANSPORT == COM_TRANSPORT_TCP || TELEMETRY_UDP
+        bool openContext();
+#endif
+#if COM_TRANSPORT == COM_TRANSPORT_TCP
+        bool isConnected();
+        bool openConnection();
+        void closeConnection();
+        bool transmit();
+        bool receive();
+#else
+        bool openSession();
+        bool readResponse();
+        void abortRequest(const RESPONSE_MSG error);
+#endif
+        bool runStage(const COM_STAGE stage);
+        void feedResponse(const char* chunk, const unsigned int length);
+        bool isResponseComplete();
+        bool decodeResponse();
+        const char* keepString(aJsonObject *item);
 };
 
+typedef HTTPComT<SIM808Modem, sim808> HTTPCom;
+
 
 /**
  * 交互工具
+ * 信息停留不阻塞：显示后开始计时 -> 下条信息显示前等待停留结束 / 循环终止时到期清除
+ *                                   displayXXX                     update
+ * SCREEN / screen - 显示模块驱动类型及实例（编译时绑定 直接调用无虚函数开销）
  */
-class Display {
+template <class SCREEN, SCREEN &screen>
+class DisplayT {
     public:
-        Display();
+        DisplayT();
 
         bool isDisplaying();
 
-        void displayWait();
+        void displayWait(const bool hold = true);
         void displayClear();
         void displayComMSG(const RESPONSE_MSG msg);
         void displayDetails(const RESPONSE_MSG msg, const char* userID, const char* balance, const char* duration = "");
         void displayCardMSG(const CARD_MSG msg);
 
+        void update();
+
     private:
         bool _isDisplaying;
 
 		const unsigned long DURATION_SHORT = 50;
-        const unsigned long DURATION = 5000;
-        const unsigned long DURATION_LONG = 10000;
+        // 各信息停留时间见运行参数（CONFIG_DISPLAY_*）
 
         char* CHAR_COM = (TAG_COM + ":").c_str();
         char* CHAR_COM_RES = (TAG_COM_RES + ":").c_str();
@@ -331,30 +1251,384 @@ class Display {
         const int LINE_3_OF_3 = 60;
 };
 
+typedef DisplayT<U8GLIB_SH1106_128X64, u8g> Display;
+
+
+/**
+ * 主循环耗时统计工具
+ * 使用流程：记录开始时间 -> 结束时记录耗时 -> 需要上传：开始上传  -> 逐段生成统计记录 -> 该段上传成功：清空该段 -> 直至全部上传
+ *           micros           record            needUpload   beginUpload  nextPiece           pieceUploaded             isUploaded
+ */
+class Profiler {
+    public:
+        Profiler();
+
+        void record(const PROFILE_PHASE phase, const unsigned long start);
+        void record(const COM_STAGE stage, const unsigned long start);
+
+        Histogram* getStage(const COM_STAGE stage);
+        void resetStages();
+        void resetPhase(const PROFILE_PHASE phase);
+
+        bool needUpload();
+        void postponeUpload();
+
+        void beginUpload();
+        String nextPiece();
+        void pieceUploaded();
+        bool isUploaded();
+
+    private:
+        // 上传间隔
+        const unsigned long UPLOAD_INTERVAL = 60UL * 60 * 1000;    // ms
+        // 每段统计记录长度上限（超出时分段上传 避免请求过长）
+        static const unsigned int UPLOAD_PIECE_LENGTH = 160;
+
+        Histogram _phases[PHASE_COUNT];
+        unsigned long _lastUpload;
+        int _uploadCursor;          // 本次上传下一段起始阶段
+        int _pieceEnd;              // 当前段结束阶段（不含）
+
+        int findStage(const COM_STAGE stage);
+        int getCode(const int phase);
+        bool isStageStats(const int phase);
+};
+
+
+// 通讯模块启动步骤（每次检查发送一条指令 下次检查时读取回复）
+enum MODEM_STEP {
+    MODEM_STEP_AT,                  // 通讯模块响应
+    MODEM_STEP_CFUN,                // 全功能模式
+    MODEM_STEP_CPIN,                // SIM卡就绪
+    MODEM_STEP_CREG,                // 网络注册
+    MODEM_STEP_COUNT,
+};
+
+/**
+ * 分阶段启动工具
+ * 本地外设在setup内立即就绪 通讯模块初始化及网络注册在主循环内逐步完成（不阻塞借车）
+ * 通讯模块各步骤：本次检查发送指令 -> 下次检查时读取已到达的回复（未到达视为未响应 重新发送）
+ * 使用流程：本地外设就绪时记录 -> 每循环推进通讯模块启动 -> 上传启动耗时
+ *           mark                  pollModem                 toString
+ * MODEM / modem - 通讯定位模块驱动类型及实例（编译时绑定）
+ */
+template <class MODEM, MODEM &modem>
+class BootSequenceT {
+    public:
+        BootSequenceT();
+
+        void mark(const BOOT_STAGE stage);
+        bool isDone(const BOOT_STAGE stage);
+
+        bool pollModem();
+
+        String toString();
+        bool isReported();
+        void setReported();
+
+    private:
+        // 通讯模块检查间隔
+        const unsigned long MODEM_POLL_INTERVAL = 1000;     // ms
+
+        // 回复读取字符间隔（回复已在串口缓冲区中 仅需读完）
+        const unsigned int REPLY_CHAR_TIMEOUT = 20;         // ms
+
+        // 各阶段完成时间（上电起 ms 0表示未完成）
+        unsigned long _doneAt[BOOT_STAGE_COUNT];
+        unsigned long _lastPoll;
+        bool _reported;
+
+        MODEM_STEP _modemStep;
+        bool _awaitingReply;        // 已发送当前步骤指令 等待回复
+
+        void sendStep();
+        bool readStep();
+};
+
+typedef BootSequenceT<SIM808Modem, sim808> BootSequence;
+
+
+/**
+ * 低功耗工具
+ * 循环间隔内单片机进入掉电休眠（看门狗定时唤醒 休眠时间计入系统时间）
+ * 距下次使用通讯模块较久时通讯模块同时进入休眠（AT+CSCLK=2 收到数据时唤醒）
+ * 使用流程：循环终止时休眠 -> 使用通讯模块前唤醒
+ *           idle              wakeModem
+ */
+class PowerManager {
+    public:
+        PowerManager();
+
+        void idle(const unsigned long duration, const unsigned long modemIdle);
+        void sleep(const unsigned long duration);
+
+        void sleepModem();
+        void wakeModem();
+
+        void interruptSleep();
+
+        unsigned long getSleptTime();
+
+    private:
+        // 通讯模块休眠所需最短空闲时间
+        const unsigned long MODEM_SLEEP_MIN = 30000;    // ms
+
+        // 看门狗最短周期
+        const unsigned long WDT_PERIOD_MIN = 16;        // ms
+
+        // 通讯模块唤醒等待时间
+        const unsigned long MODEM_WAKE_DELAY = 100;     // ms
+
+        unsigned long _sleptTime;
+        bool _modemAsleep;
+        volatile bool _interrupted;     // 外部中断唤醒 结束本次休眠
+
+        void sleepWDT(const int period);
+        void sleepIdle(const unsigned long duration);
+};
+
+
+/**
+ * 电池电量工具
+ * 低频采样：ADC过采样后抽取（10 bit -> 12 bit）-> 指数滑动平均滤波 -> 缓存
+ * 通讯模块空闲时以AT+CBC读取的电压交叉校验 偏差过大时采用通讯模块读数
+ * 使用流程：每循环更新（未到采样时间时直接返回）-> 读取缓存电量
+ *           update                                  getLevel
+ *           通讯模块唤醒时：交叉校验
+ *                           crossCheck
+ */
+class BatteryMonitor {
+    public:
+        BatteryMonitor();
+
+        void update();
+        bool crossCheck();
+
+        float getLevel();
+        float getVoltage();
+
+    private:
+        // 采样间隔
+        const unsigned long SAMPLE_INTERVAL = 10000;        // ms
+        // 交叉校验间隔
+        const unsigned long CROSS_CHECK_INTERVAL = 300000;  // ms
+
+        // 过采样位数（采样 4^n 次 右移 n 位）
+        static const int OVERSAMPLE_BITS = 2;
+        static const int OVERSAMPLE_COUNT = 1 << (2 * OVERSAMPLE_BITS);
+        static const long ADC_MAX = (1024L << OVERSAMPLE_BITS) - 1;
+
+        // 参考电压与分压比
+        const float ADC_REFERENCE = 5.0;                    // V
+        const float DIVIDER_RATIO = 2.0;
+
+        // 电量对应电压范围（单节锂电池）
+        const float VOLTAGE_EMPTY = 3.40;                   // V
+        const float VOLTAGE_FULL = 4.20;                    // V
+        // 低于此电压视为未接入（读数无效）
+        const float VOLTAGE_MIN_VALID = 2.50;               // V
+
+        // 滤波系数（越小越平滑）
+        const float FILTER_ALPHA = 0.25;
+
+        // 交叉校验允许偏差
+        const float CROSS_CHECK_TOLERANCE = 0.15;           // V
+
+        float _voltage;
+        float _level;
+        bool _hasSample;
+        unsigned long _lastSample;
+        unsigned long _lastCrossCheck;
+
+        float sampleVoltage();
+        void filter(const float voltage);
+};
+
+
+/**
+ * 引脚驱动（车锁默认驱动 直接调用Arduino引脚函数）
+ */
+struct ArduinoPin {
+    static void mode(const int pin, const int mode) { pinMode(pin, mode); }
+    static void write(const int pin, const int value) { digitalWrite(pin, value); }
+};
 
 /**
  * 车锁控制工具
+ * PIN - 引脚驱动类型（提供静态 mode / write）
  */
-class Lock {
+template <class PIN>
+class LockT {
     public:
-        Lock();
+        LockT();
 
+        void attach(const int pin);
         void unlock();
 
     private:
         const unsigned long DURATION = 5000;
+
+        int _pin;
+};
+
+typedef LockT<ArduinoPin> Lock;
+
+
+#if SERVER_WAKE
+/**
+ * 服务器唤醒工具
+ * 通讯模块收到短信或数据时RI引脚拉低 -> 外部中断唤醒单片机 -> 新短信提示（+CMTI）给出存储位置 -> 读取该短信 -> 唤醒口令有效时立即定位
+ * 仅在收到新短信提示后发送短信指令 避免指令交互读走串口中待处理的数据
+ * UDP遥测时串口数据（确认及新短信提示）由通讯工具读取 新短信提示经 notify 转交（须在 poll 之前读取）
+ * 使用流程：网络注册完成后开始 -> 每循环检查 -> 有效唤醒：立即定位
+ *           begin                   poll            true: LOCATION.requestUpdate
+ * MODEM / modem - 通讯定位模块驱动类型及实例（编译时绑定 直接调用无虚函数开销）
+ */
+template <class MODEM, MODEM &modem>
+class ServerWakeT {
+    public:
+        ServerWakeT();
+
+        void begin();
+        bool poll();
+        void notify(const char* data);
+
+    private:
+        // 唤醒短信口令（短信须以此开头）
+        const char* WAKE_TOKEN = "CBS-WAKE";
+
+        // 短信读取长度
+        static const int MESSAGE_SIZE = 32;
+
+        // 新短信提示读取（单次最大长度 / 字符间隔）
+        static const unsigned int URC_BUFFER_SIZE = 48;
+        const unsigned int URC_CHAR_TIMEOUT = 20;       // ms
+
+        static volatile bool _ringing;
+        bool _started;
+        int _messageIndex;          // 待读取短信的存储位置（0 - 无）
+
+        static void onRing();
+        void armInterrupt();
+};
+
+typedef ServerWakeT<SIM808Modem, sim808> ServerWake;
+#endif
+
+
+struct ConfigRange {
+    unsigned int defaultValue;      // 默认值（未下发或下发无效时使用）
+    unsigned int minValue;          // 下发值下限
+    unsigned int maxValue;          // 下发值上限
+};
+
+// 运行参数默认值及有效范围：[运行参数]
+// 服务器可随时唤醒时 未借用状态仅需低频定位；不可用状态可能由本地通讯失败造成（服务器无从唤醒） 保持短间隔以便恢复
+constexpr ConfigRange CONFIG_RANGES[CONFIG_PARAM_COUNT] = {
+    { 60,       10,     3600 },     // CONFIG_UPDATE_RENT
+#if SERVER_WAKE
+    { 3600,     60,     65535 },    // CONFIG_UPDATE_NOT_RENT
+#else
+    { 600,      60,     65535 },    // CONFIG_UPDATE_NOT_RENT
+#endif
+    { 300,      60,     65535 },    // CONFIG_UPDATE_NOT_AVAILABLE
+    { 30000,    5000,   60000 },    // CONFIG_GPS_OVERTIME
+    { 200,      50,     2000 },     // CONFIG_INTERVAL_SHORT
+    { 1000,     200,    5000 },     // CONFIG_INTERVAL_LONG
+    { CARD_MIN_READING, 1, 20 },    // CONFIG_CARD_MIN_READING
+    { CARD_MIN_DETATCH, 1, 20 },    // CONFIG_CARD_MIN_DETATCH
+    { 2000,     0,      10000 },    // CONFIG_DISPLAY_WAIT
+    { 5000,     1000,   30000 },    // CONFIG_DISPLAY
+    { 10000,    1000,   60000 },    // CONFIG_DISPLAY_LONG
+};
+
+/**
+ * 运行参数工具
+ * 服务器随定位回复下发参数块（版本号 + 以'.'分隔的各参数值 依次对应CONFIG_PARAM 可省略末尾参数）
+ * 校验有效后存入EEPROM 各工具使用参数时读取 即时生效（用于分批试验不同时序参数）
+ * 使用流程：启动时恢复 -> 收到新版本时保存 -> 各工具读取
+ *           restore        store               get
+ */
+class RuntimeConfig {
+    public:
+        RuntimeConfig();
+
+        bool restore();
+        bool store(const unsigned int version, const char* config);
+
+        unsigned int get(const CONFIG_PARAM param);
+        unsigned int getVersion();
+
+    private:
+        // EEPROM内布局：版本号 各参数值 校验
+        struct Block {
+            unsigned int version;
+            unsigned int values[CONFIG_PARAM_COUNT];
+            unsigned char check;
+        };
+
+        unsigned int _version;
+        unsigned int _values[CONFIG_PARAM_COUNT];
+
+        void loadDefaults();
+        unsigned char checksum(const Block &block);
+};
+
+
+/**
+ * 请求编号工具
+ * 每次借车 / 还车操作分配单调递增的编号（各槽位独立） 重试及补发时沿用 服务器据此识别重复请求并重放原结果
+ * EEPROM中仅保存已预留的编号上限（每次预留一批 减少写入） 重启后从上限之后继续 未用完的编号跳过
+ * 待确认借车的编号随借还状态日志保存 重启后补发时沿用
+ * 使用流程：启动时恢复 -> 新操作时分配
+ *           restore       issue
+ */
+class RequestIds {
+    public:
+        RequestIds();
+
+        void restore();
+
+        unsigned long issue(const int slot);
+
+    private:
+        // 每次预留编号数
+        static const unsigned long RESERVE_BLOCK = 32;
+
+        // EEPROM内布局（每槽位）：预留上限 校验
+        struct Block {
+            unsigned long reserved;
+            unsigned char check;
+        };
+
+        unsigned long _last[STATION_SLOT_COUNT];        // 最近分配的编号
+        unsigned long _reserved[STATION_SLOT_COUNT];    // 当前预留上限
+
+        unsigned char checksum(const Block &block);
 };
 
 
 //////////////////////////////////////
 // --------- 全局工具实例 --------- //
 //////////////////////////////////////
-extern RentState        RENTSTATE;
-extern Card             CARD;
+extern Timer            TIMER;
+extern RentState        RENTSTATES[STATION_SLOT_COUNT];
+extern Card             CARDS[STATION_SLOT_COUNT];
+extern CardCache        CARDCACHE;
+extern CardHistory      CARDHISTORY;
 extern LocationUpdate   LOCATION;
 extern HTTPCom          HTTPCOM;
 extern Display          DISPLAYS;
-extern Lock             LOCK;
+extern Lock             LOCKS[STATION_SLOT_COUNT];
+extern Profiler         PROFILER;
+extern PowerManager     POWER;
+extern BootSequence     BOOT;
+extern BatteryMonitor   BATTERY;
+extern RuntimeConfig    CONFIG;
+extern RequestIds       REQUESTIDS;
+#if SERVER_WAKE
+extern ServerWake       WAKE;
+#endif
 
 //////////////////////////////////////
 // ----------- 全局函数 ----------- //
@@ -363,7 +1637,18 @@ extern Lock             LOCK;
  * 时间工具
  */
 unsigned long sysTime();
-inline bool withinInterval(const unsigned long start, const unsigned long end, const unsigned long interval);
+
+/**
+ * 判断两个时间点之间是否满足间隔（无符号减法 溢出后仍然正确）
+ * @param  start    开始时间
+ * @param  end      结束时间
+ * @param  interval 间隔时间
+ * @return          true - 在间隔内
+ *                  false - 不在间隔内
+ */
+inline bool withinInterval(const unsigned long start, const unsigned long end, const unsigned long interval) {
+    return end - start < interval;
+}
 
 /**
  * 电池电量工具
@@ -381,6 +1666,17 @@ void Log(const RENT_STATE log);
 
 void Error(const String error);
 
+/**
+ * 记录通讯过程
+ */
+void Trace(const COM_STAGE stage, const unsigned long start, const bool result, const String data = "");
+
+/**
+ * 性能测试工具
+ */
+int freeMemory();
+void runBenchmark();
+
 /**
  * 系统初始化
  */
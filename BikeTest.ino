@@ -1,191 +1,438 @@
 #include "BikeLib.h"
 
-// 车辆编号
-const int BIKEID = 1;
-
-// 最大请求次数
-const int MAX_REQUEST_COUNT = 5;
+// 车辆编号（车桩模式下依次对应各槽位 个数须等于STATION_SLOT_COUNT）
+#ifndef STATION_BIKEIDS
+#define STATION_BIKEIDS { 1 }
+#endif
+const int BIKEIDS[] = STATION_BIKEIDS;
+static_assert(sizeof(BIKEIDS) / sizeof(BIKEIDS[0]) == STATION_SLOT_COUNT, "STATION_BIKEIDS must list one bike per slot");
 
 // 低电量阈值
 const float LOW_BATTERY_THRESHOLD = 0.5;
 
-// 全局变量
-unsigned long serNum;
+// 乐观开锁：近期连续借车成功的卡片先开锁后确认（默认关闭 未经服务器授权即开锁 按部署评估后开启）
+const bool OPTIMISTIC_UNLOCK = false;
+
+// 本地授权借车补发请求间隔
+const unsigned long RENT_CONFIRM_INTERVAL = 30000;  // ms
+
+// 低电量信息发送间隔（HTTP：发送成功后的冷却; UDP遥测：未确认记录随之后的数据报重发）
+const unsigned long LOW_BATTERY_PING_INTERVAL = 600000;  // ms
+
+// 全局变量（各槽位）
+unsigned long serNum[STATION_SLOT_COUNT];
 float batteryLevel = 1.00;
 
+// 本地授权（或乐观开锁）借车补发时间（待确认标志随借还状态保存）
+unsigned long lastRentConfirm[STATION_SLOT_COUNT];
+
+// 低电量信息最近发送时间（HTTP：最近发送成功时间）
+unsigned long lastLowBatteryPing[STATION_SLOT_COUNT];
+
+// 读卡消息队列（某槽位阻塞操作期间其余槽位照常寻卡 消息入队 轮到该槽位时依次处理）
+struct CardEvent {
+    CARD_MSG msg;
+    unsigned long serial;           // 消息产生时的卡片序列号
+};
+const int CARD_QUEUE_SIZE = 4;
+CardEvent cardQueue[STATION_SLOT_COUNT][CARD_QUEUE_SIZE];
+int cardQueueCount[STATION_SLOT_COUNT];
+unsigned long lastQueuedSearch[STATION_SLOT_COUNT];
+
+// 正在处理的槽位（-1 - 无）
+int servingSlot = -1;
+
+// 函数声明
+void serveSlot(const int slot);
+bool confirmRent(const int slot);
+void pollOtherReaders();
+
 
 // 初始化
 void setup() {
     Serial.begin(9600);
+
+#if BENCHMARK_HOST
+    // 主机端构建仅运行性能测试（不初始化外设）
+    runBenchmark();
+    exit(0);
+#endif
+
     SPI.begin();
 
+    // 恢复运行参数（其余工具使用参数前）
+    CONFIG.restore();
+
+    // 恢复请求编号预留上限（借车还车请求前）
+    REQUESTIDS.restore();
+
+    // 恢复各槽位借还状态（无需服务器）
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        RENTSTATES[slot].attach(slot);
+        if (RENTSTATES[slot].restore()) {
+            serNum[slot] = RENTSTATES[slot].getCardSerial();
+            if (RENTSTATES[slot].getState() == RENT) {
+                CARDS[slot].restore(serNum[slot]);
+            }
+        }
+    }
+    BOOT.mark(BOOT_RESTORE);
+
     Log(TAG_SETUP, "Seting up...");
     while(!setupInit()) {
         Log(TAG_SETUP, "Setup Fail! Retrying...");  
     }
 
     Log(TAG_SETUP, "Setup Success!");
+
+    // 阻塞等待（开锁保持 重试退避 信息停留）期间为其余槽位寻卡
+    TIMER.setWaitHook(pollOtherReaders);
+
+    // 性能测试
+    if (isBenchmark) {
+        runBenchmark();
+    }
 }
 
 
 // 主程序
 void loop() {
 
+    unsigned long profileStart;
+
+    // 通讯模块启动（网络注册完成前仅可本地授权借车）
+    if (BOOT.pollModem()) {
+        Log(TAG_BOOT, "Network ready: " + BOOT.toString());
+
+        // 各车辆重试抖动互不相同（注册耗时随通讯模块而变）
+        randomSeed(BIKEIDS[0] ^ micros());
+
+#if SERVER_WAKE
+        WAKE.begin();
+#endif
+    }
+
+#if TELEMETRY_UDP
+    // 处理已到达的遥测确认（车辆可用状态随确认下发）
+    HTTPCOM.pollTelemetry();
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        RentState &rentState = RENTSTATES[slot];
+        if (HTTPCOM.hasAvailability(slot)) {
+            switch (HTTPCOM.getAvailability(slot)) {
+                case LOCATION_SUCCESS:
+                Log(TAG_TELEMETRY, "Bike Available");
+                    if (!rentState.isAvailable()) {
+                        // 车辆状态：未借用
+                        rentState.changeState(NOT_RENT);
+                    }
+                break;
+
+                case LOCATION_SUCCESS_NOT_AVAILABLE:
+                Log(TAG_TELEMETRY, "Bike Not Available");
+                    // 骑行状态中车辆状态不应发生改变，否则无法还车
+                    if (rentState.getState() != RENT) {
+                        // 车辆状态：不可用
+                        rentState.changeState(NOT_AVAILABLE);
+                    }
+                break;
+
+                default:
+                break;
+            }
+        } else if (HTTPCOM.isTelemetryStalled() && rentState.getState() != RENT) {
+            // 未确认记录已满 视为服务器不可达
+            rentState.changeState(NOT_AVAILABLE);
+        }
+    }
+#endif
+
+#if SERVER_WAKE
+    // 服务器唤醒短信：立即定位并交换车辆状态（遥测确认读取之后 短信指令不会读走确认）
+    if (WAKE.poll()) {
+        LOCATION.requestUpdate();
+    }
+#endif
+
     // 检查电量
+    profileStart = micros();
     batteryLevel = readBatteryLevel();
+    PROFILER.record(PHASE_BATTERY, profileStart);
     Log(TAG_LOOP, "battery Level Read!");
 
     // 检查电量是否过低
-    if (batteryLevel <= LOW_BATTERY_THRESHOLD && RENTSTATE.getState() != RENT) {
-      Log("Low Battery Level");// 删掉
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        RentState &rentState = RENTSTATES[slot];
+        if (batteryLevel <= LOW_BATTERY_THRESHOLD && rentState.getState() != RENT) {
+          Log("Low Battery Level");// 删掉
+
+            // 车辆状态：不可用
+            rentState.changeState(NOT_AVAILABLE);
+
+#if TELEMETRY_UDP
+            // UDP发送 不等待回复（发送间隔内不重复发送）
+            if (BOOT.isDone(BOOT_NETWORK) && (lastLowBatteryPing[slot] == 0 || !withinInterval(lastLowBatteryPing[slot], sysTime(), LOW_BATTERY_PING_INTERVAL))) {
+                HTTPCOM.sendLowBattery(slot, BIKEIDS[slot], batteryLevel);
+                lastLowBatteryPing[slot] = sysTime();
+            }
+            continue;
+#endif
 
-        // 车辆状态：不可用
-        RENTSTATE.changeState(NOT_AVAILABLE);
+            // 发送成功后间隔内不重复发送
+            if (lastLowBatteryPing[slot] != 0 && withinInterval(lastLowBatteryPing[slot], sysTime(), LOW_BATTERY_PING_INTERVAL)) {
+                continue;
+            }
 
-        bool lowBatSuccess = false;
-        int returnCount = 0;
+            bool lowBatSuccess = false;
 
-        // 反复请求低电量直至成功
-        // 待查：死循环
-        while (!lowBatSuccess) {
-            // 请求低电量
-            lowBatSuccess = HTTPCOM.requestLowBattery(BIKEID, batteryLevel);
+            // 按重试策略请求低电量（预算用尽后冷却 期间不再请求）
+            HTTPCOM.beginRetry(RETRY_LOWBATTERY);
+            while (!lowBatSuccess && BOOT.isDone(BOOT_NETWORK) && HTTPCOM.retry(RETRY_LOWBATTERY)) {
+                // 请求低电量
+                lowBatSuccess = HTTPCOM.requestLowBattery(BIKEIDS[slot], batteryLevel);
 
-            if (lowBatSuccess) {
-                if (HTTPCOM.hasResponse()) {
-                    Log(TAG_LOCATION, "hasResponse");
+                if (lowBatSuccess) {
+                    if (HTTPCOM.hasResponse()) {
+                        Log(TAG_LOCATION, "hasResponse");
 
-                    switch (HTTPCOM.getResponse()) {
-                        case LOWBATTERY_SUCCESS:
-                        // 低电量信息发送成功
-                        Log(TAG_COM_RES, "Low Battery Success!");
-                        break;
+                        switch (HTTPCOM.getResponse()) {
+                            case LOWBATTERY_SUCCESS:
+                            // 低电量信息发送成功
+                            Log(TAG_COM_RES, "Low Battery Success!");
+                                lastLowBatteryPing[slot] = sysTime();
+                            break;
 
-                        case LOWBATTERY_FAIL:
-                        // 低电量信息发送失败
-                        Log(TAG_COM_RES, "Backend Error! Retrying...");
+                            case LOWBATTERY_FAIL:
+                            // 低电量信息发送失败
+                            Log(TAG_COM_RES, "Backend Error! Retrying...");
 
-                            lowBatSuccess = false;
-                        break;
+                                lowBatSuccess = false;
+                            break;
 
+                            default:
+                            Error(TAG_COM_MSG + ": " + (int) HTTPCOM.getResponse());
+                            break;
+                        }
+                    } else {
+                        Error(TAG_COM + ": hasResponse FALSE");
+                    }
+                } else {
+                    // 获取错误信息
+                    switch (HTTPCOM.getError()) {
+                        case ERROR_STATUS:              // 请求状态错误
+                        case ERROR_REQUEST_OVERTIME:    // 请求超时
+                        case ERROR_INVALID_RESPONSE:    // 接收信息无效
+                        case ERROR_DECODE:              // 回复信息解码错误
+                        Log(TAG_COM_RES, "Backend Not Reached! Retrying...");
+                        Log(HTTPCOM.getResponse());
+                        break;
                         default:
-                        Error(TAG_COM_MSG + ": " + (int) HTTPCOM.getResponse());
+                        Error(TAG_COM_RES + ": " + (int) HTTPCOM.getResponse());
                         break;
                     }
-                } else {
-                    Error(TAG_COM + ": hasResponse FALSE");
-                }
-            } else {
-                // 获取错误信息
-                switch (HTTPCOM.getError()) {
-                    case ERROR_STATUS:              // 请求状态错误
-                    case ERROR_REQUEST_OVERTIME:    // 请求超时
-                    case ERROR_INVALID_RESPONSE:    // 接收信息无效
-                    case ERROR_DECODE:              // 回复信息解码错误
-                    Log(TAG_COM_RES, "Backend Not Reached! Retrying...");
-                    Log(HTTPCOM.getResponse());
-                    break;
-                    default:
-                    Error(TAG_COM_RES + ": " + (int) HTTPCOM.getResponse());
-                    break;
                 }
             }
         }
     }
     
     // 定位及反馈
-   if (LOCATION.needUpdate(RENTSTATE.getState())) {
+   profileStart = micros();
+   bool needUpdate = false;
+   for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+       needUpdate = needUpdate || LOCATION.needUpdate(RENTSTATES[slot].getState());
+   }
+   needUpdate = needUpdate && BOOT.isDone(BOOT_NETWORK);
+   PROFILER.record(PHASE_NEED_UPDATE, profileStart);
+   if (needUpdate) {
        Log(TAG_LOCATION, "Location Updating...");
 
        // 定位
+       profileStart = micros();
        bool updateSuccess = LOCATION.doUpdate();
+       PROFILER.record(PHASE_DO_UPDATE, profileStart);
        Log(TAG_LOCATION, "Location Update Complete " + (int) updateSuccess);
 
-       // 发送信息
-       bool requestUpdateSuccess;
-       if (updateSuccess) {
-           requestUpdateSuccess = HTTPCOM.requestLocation(BIKEID, LOCATION.getLongitude(), LOCATION.getLatitude(), batteryLevel);
-       } else {
-           requestUpdateSuccess = HTTPCOM.requestLocationFail(BIKEID, batteryLevel);
+       // 通讯模块已唤醒 校验电量
+       if (BATTERY.crossCheck()) {
+           batteryLevel = BATTERY.getLevel();
        }
 
-       // 检查回复
-       if (requestUpdateSuccess) {
-           if (HTTPCOM.hasResponse()) {
-               Log(TAG_LOCATION, "hasResponse");
-
-               switch (HTTPCOM.getResponse()) {
-                   case LOCATION_SUCCESS:
-                   // 定位信息发送成功
-                   Log(TAG_COM_RES, "Location Success!");
+       // 发送信息（各槽位共用定位结果）
+       for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+           RentState &rentState = RENTSTATES[slot];
+
+#if TELEMETRY_UDP
+           // UDP发送 不等待回复（卡片缓存或运行参数过期时改用HTTP请求 随回复下发）
+           if (!HTTPCOM.needSync()) {
+               if (updateSuccess) {
+                   HTTPCOM.sendLocation(slot, BIKEIDS[slot], LOCATION.getLongitude(), LOCATION.getLatitude(), batteryLevel);
+               } else {
+                   HTTPCOM.sendLocationFail(slot, BIKEIDS[slot], batteryLevel);
+               }
+               continue;
+           }
+           Log(TAG_TELEMETRY, "Cache or config outdated, syncing over HTTP");
+#endif
 
-                       if (!RENTSTATE.isAvailable()) {
-                           // 车辆状态：未借用
-                           RENTSTATE.changeState(NOT_RENT);
-                       }
-                   break;
+           bool requestUpdateSuccess;
+           if (updateSuccess) {
+               requestUpdateSuccess = HTTPCOM.requestLocation(BIKEIDS[slot], LOCATION.getLongitude(), LOCATION.getLatitude(), batteryLevel);
+           } else {
+               requestUpdateSuccess = HTTPCOM.requestLocationFail(BIKEIDS[slot], batteryLevel);
+           }
 
-                   case LOCATION_SUCCESS_NOT_AVAILABLE:
-                   // 定位信息发送成功 车辆不可用
-                   Log(TAG_COM_RES, "Backend Reached! Bike Not Available");
+           // 检查回复
+           if (requestUpdateSuccess) {
+               if (HTTPCOM.hasResponse()) {
+                   Log(TAG_LOCATION, "hasResponse");
+
+                   switch (HTTPCOM.getResponse()) {
+                       case LOCATION_SUCCESS:
+                       // 定位信息发送成功
+                       Log(TAG_COM_RES, "Location Success!");
+
+                           if (!rentState.isAvailable()) {
+                               // 车辆状态：未借用
+                               rentState.changeState(NOT_RENT);
+                           }
+                       break;
+
+                       case LOCATION_SUCCESS_NOT_AVAILABLE:
+                       // 定位信息发送成功 车辆不可用
+                       Log(TAG_COM_RES, "Backend Reached! Bike Not Available");
                         
-                       // 骑行状态中车辆状态不应发生改变，否则无法还车
-                       if (RENTSTATE.getState() != RENT) {
-                           // 车辆状态：不可用
-                           RENTSTATE.changeState(NOT_AVAILABLE);
-                       }
-                   break;
-
-                   case LOCATION_FAIL:
-                   // 定位信息发送失败
-                   Log(TAG_COM_RES, "Backend Error! Bike Not Available");
+                           // 骑行状态中车辆状态不应发生改变，否则无法还车
+                           if (rentState.getState() != RENT) {
+                               // 车辆状态：不可用
+                               rentState.changeState(NOT_AVAILABLE);
+                           }
+                       break;
+
+                       case LOCATION_FAIL:
+                       // 定位信息发送失败
+                       Log(TAG_COM_RES, "Backend Error! Bike Not Available");
                         
-/*                     定位失败不需要改变车辆状态，否则一旦定位失败车辆就再也无法使用  
-                       if (RENTSTATE.getState() != RENT) {
-                           // 车辆状态：不可用
-                           RENTSTATE.changeState(NOT_AVAILABLE);
-                       }*/
+    /*                     定位失败不需要改变车辆状态，否则一旦定位失败车辆就再也无法使用  
+                           if (rentState.getState() != RENT) {
+                               // 车辆状态：不可用
+                               rentState.changeState(NOT_AVAILABLE);
+                           }*/
+                       break;
+
+                       default:
+                       Error(TAG_COM_MSG + ": " + (int) HTTPCOM.getResponse());
+                       break;
+                   }
+               } else {
+                   Error(TAG_COM + ": hasResponse FALSE");
+               }
+           } else {
+               // 获取错误信息
+               switch (HTTPCOM.getError()) {
+                   case ERROR_STATUS:              // 请求状态错误
+                   case ERROR_REQUEST_OVERTIME:    // 请求超时
+                   case ERROR_INVALID_RESPONSE:    // 接收信息无效
+                   case ERROR_DECODE:              // 回复信息解码错误
+                   Log(TAG_COM_RES, "Backend Not Reached! Bike Not Available");
+                   Log(HTTPCOM.getResponse());
+                           // 骑行状态中车辆状态不应发生改变，否则无法还车  
+                           if (rentState.getState() != RENT) {
+                               // 车辆状态：不可用
+                               rentState.changeState(NOT_AVAILABLE);
+                           }
                    break;
-
                    default:
-                   Error(TAG_COM_MSG + ": " + (int) HTTPCOM.getResponse());
+                   Error(TAG_COM_RES + ": " + (int) HTTPCOM.getResponse());
                    break;
                }
-           } else {
-               Error(TAG_COM + ": hasResponse FALSE");
-           }
-       } else {
-           // 获取错误信息
-           switch (HTTPCOM.getError()) {
-               case ERROR_STATUS:              // 请求状态错误
-               case ERROR_REQUEST_OVERTIME:    // 请求超时
-               case ERROR_INVALID_RESPONSE:    // 接收信息无效
-               case ERROR_DECODE:              // 回复信息解码错误
-               Log(TAG_COM_RES, "Backend Not Reached! Bike Not Available");
-               Log(HTTPCOM.getResponse());
-                       // 骑行状态中车辆状态不应发生改变，否则无法还车  
-                       if (RENTSTATE.getState() != RENT) {
-                           // 车辆状态：不可用
-                           RENTSTATE.changeState(NOT_AVAILABLE);
-                       }
-               break;
-               default:
-               Error(TAG_COM_RES + ": " + (int) HTTPCOM.getResponse());
-               break;
            }
        }
 
+       // 随定位周期分段上传耗时统计（任一段失败则推迟 已上传的段不重复上传）
+       if (PROFILER.needUpload() || !BOOT.isReported()) {
+           bool uploadSuccess;
+           PROFILER.beginUpload();
+           do {
+               String boot = BOOT.isReported() ? "" : BOOT.toString();
+               uploadSuccess = HTTPCOM.requestProfile(BIKEIDS[0], PROFILER.nextPiece(), boot) && HTTPCOM.hasResponse() && HTTPCOM.getResponse() == PROFILE_SUCCESS;
+               if (uploadSuccess) {
+                   PROFILER.pieceUploaded();
+                   BOOT.setReported();
+               }
+           } while (uploadSuccess && !PROFILER.isUploaded());
+
+           if (uploadSuccess) {
+               Log(TAG_PROFILE, "Profile Uploaded!");
+           } else {
+               Log(TAG_PROFILE, "Profile Upload Fail!");
+               PROFILER.postponeUpload();
+           }
+       }
    }
 
-    // 读卡操作
-    switch (CARD.searchCard(RENTSTATE.getState())) {
+    // 各槽位借还车（共用通讯模块 按槽位依次请求 阻塞期间其余槽位读卡消息入队）
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        servingSlot = slot;
+        serveSlot(slot);
+    }
+    servingSlot = -1;
+
+    // 循环终止操作
+    profileStart = micros();
+    loopTerm();
+    PROFILER.record(PHASE_LOOP_TERM, profileStart);
+}
+
+
+/**
+ * 单个槽位的借还车操作（补发借车请求 -> 读卡 -> 借还车）
+ * @param slot 槽位编号
+ */
+void serveSlot(const int slot) {
+    RentState &rentState = RENTSTATES[slot];
+    Card &card = CARDS[slot];
+    Lock &lock = LOCKS[slot];
+
+    unsigned long profileStart;
+
+    // 补发本地授权借车请求
+    if (rentState.isPending() && rentState.getState() == RENT && !withinInterval(lastRentConfirm[slot], sysTime(), RENT_CONFIRM_INTERVAL)) {
+        lastRentConfirm[slot] = sysTime();
+        rentState.setPending(!confirmRent(slot));
+    }
+
+    // 读卡操作（先处理其余槽位阻塞期间入队的消息）
+    CARD_MSG cardMSG;
+    unsigned long cardSerial;
+    if (cardQueueCount[slot] > 0) {
+        cardMSG = cardQueue[slot][0].msg;
+        cardSerial = cardQueue[slot][0].serial;
+        cardQueueCount[slot]--;
+        for (int i = 0; i < cardQueueCount[slot]; i++) {
+            cardQueue[slot][i] = cardQueue[slot][i + 1];
+        }
+    } else {
+        profileStart = micros();
+        cardMSG = card.searchCard(rentState.getState());
+        cardSerial = card.getSerNum();
+        PROFILER.record(PHASE_SEARCH_CARD, profileStart);
+    }
+    switch (cardMSG) {
         case NEW_CARD_DETECTED:
         // 发现新卡片（亦可能识别错误）
         Log(TAG_CARD_MSG, "NEW_CARD_DETECTED");
             
             LOCATION.pauseUpdate();
-            // 交互模块：等待
-            DISPLAYS.displayWait();
+            if (rentState.getState() == NOT_RENT) {
+                // 交互模块：等待（预先打开承载期间保持显示）
+                DISPLAYS.displayWait(false);
+                // 借车前预先打开承载（网络注册完成后）
+                if (BOOT.isDone(BOOT_NETWORK)) {
+                    HTTPCOM.prepare();
+                }
+            } else {
+                // 交互模块：等待
+                DISPLAYS.displayWait();
+            }
         break;
 
         case NEW_CARD_CONFIRMED:
@@ -194,15 +441,33 @@ void loop() {
 
             LOCATION.resumeUpdate();
 
+            // 本地授权或乐观开锁借车：立即开锁 借车请求随后确认
+            if (rentState.getState() == NOT_RENT && (CARDCACHE.contains(cardSerial) || (OPTIMISTIC_UNLOCK && CARDHISTORY.isTrusted(cardSerial)))) {
+                serNum[slot] = cardSerial;
+                Log(TAG_LOOP, "Rent authorized locally");
+
+                // 车辆状态：已借车 待确认（连同新分配的请求编号开锁前写入 开锁及确认期间重启后以同一编号补发）
+                rentState.changeState(RENT, serNum[slot], true, REQUESTIDS.issue(slot));
+
+                // 开锁
+                lock.unlock();
+                Log(TAG_LOCK, "Unlock Success!");
+
+                // 立即尝试确认 成功后清除待确认 失败则稍后补发
+                lastRentConfirm[slot] = sysTime();
+                if (confirmRent(slot)) {
+                    rentState.setPending(false);
+                }
+
             // 借车
-            if (RENTSTATE.getState() == NOT_RENT) {
+            } else if (rentState.getState() == NOT_RENT) {
 
                 // 车辆状态：借车中
-                RENTSTATE.changeState(RENT_UNDER_WAY);
+                rentState.changeState(RENT_UNDER_WAY);
                 Log(TAG_LOOP, "Rent underway...");
 
-                serNum = CARD.getSerNum();
-                if (HTTPCOM.requestRent(BIKEID, serNum)) {
+                serNum[slot] = cardSerial;
+                if (HTTPCOM.requestRent(BIKEIDS[slot], serNum[slot], REQUESTIDS.issue(slot))) {
                     if (HTTPCOM.hasResponse()) {
                         // 交互模块：返回信息
                         DISPLAYS.displayComMSG(HTTPCOM.getResponse()); 
@@ -212,16 +477,17 @@ void loop() {
                             Log(TAG_COM_RES, "Rent Success!");
                                 
                                 // 车辆状态：已借车
-                                RENTSTATE.changeState(RENT);
+                                rentState.changeState(RENT, serNum[slot]);
+                                CARDHISTORY.recordSuccess(serNum[slot]);
                                 
                                 // 开锁
-                                LOCK.unlock();
+                                lock.unlock();
                                 Log(TAG_LOCK, "Unlock Success!");
 
                                 // 交互模块：用户信息
                                 Log(TAG_COM_RES, HTTPCOM.getResponse_UserID());
                                 Log(TAG_COM_RES, HTTPCOM.getResponse_Balance());
-                                DISPLAYS.displayDetails(HTTPCOM.getResponse(), HTTPCOM.getResponse_UserID().c_str(), HTTPCOM.getResponse_Balance().c_str());
+                                DISPLAYS.displayDetails(HTTPCOM.getResponse(), HTTPCOM.getResponse_UserID(), HTTPCOM.getResponse_Balance());
                             break;
 
                             case RENT_FAIL_USER_OCCUPIED:       // 借车失败：用户正在使用其它车辆
@@ -229,9 +495,10 @@ void loop() {
                             case RENT_FAIL_NEGATIVE_BALANCE:    // 借车失败：用户欠费
                             Log(TAG_COM_RES, "Rent Fail!");
                             Log(HTTPCOM.getResponse());
+                            CARDHISTORY.recordFail(serNum[slot]);
 
                                 // 车辆状态：未借车
-                                RENTSTATE.changeState(NOT_RENT);
+                                rentState.changeState(NOT_RENT);
                             break;
 
                             case RENT_FAIL_BIKE_OCCUPIED:
@@ -240,7 +507,7 @@ void loop() {
                             // 待查
                             
                                 // 车辆状态：不可用
-                                RENTSTATE.changeState(NOT_AVAILABLE);
+                                rentState.changeState(NOT_AVAILABLE);
                             break;
 
                             case RENT_FAIL_BIKE_UNAVAILABLE:
@@ -249,7 +516,7 @@ void loop() {
                             Log(HTTPCOM.getResponse());
                                 
                                 // 车辆状态：不可用
-                                RENTSTATE.changeState(NOT_AVAILABLE);
+                                rentState.changeState(NOT_AVAILABLE);
                             break;
 
                             default:
@@ -270,7 +537,7 @@ void loop() {
                         Log(HTTPCOM.getResponse());
 
                             // 车辆状态：未借车
-                            RENTSTATE.changeState(NOT_RENT);
+                            rentState.changeState(NOT_RENT);
                         break;
                         default:
                         Error(TAG_COM_RES + ": " + (int) HTTPCOM.getResponse());
@@ -278,7 +545,7 @@ void loop() {
                     }
                 }
             } else {
-                Error(TAG_RENTSTATE + ": " + (int) RENTSTATE.getState());
+                Error(TAG_RENTSTATE + ": " + (int) rentState.getState());
                 // 待查
             }
         break;
@@ -288,8 +555,17 @@ void loop() {
         Log(TAG_CARD_MSG, "CARD_DETATCHED");
             
             LOCATION.pauseUpdate();
-            // 交互模块：等待
-            DISPLAYS.displayWait();
+            if (rentState.getState() == RENT) {
+                // 交互模块：等待（预先打开承载期间保持显示）
+                DISPLAYS.displayWait(false);
+                // 还车前预先打开承载（网络注册完成后）
+                if (BOOT.isDone(BOOT_NETWORK)) {
+                    HTTPCOM.prepare();
+                }
+            } else {
+                // 交互模块：等待
+                DISPLAYS.displayWait();
+            }
         break;
 
         case CARD_DETATCH_CONFIRMED:
@@ -298,23 +574,35 @@ void loop() {
 
             LOCATION.resumeUpdate();
 
+            // 借车尚未确认时先补发借车请求
+            if (rentState.isPending() && rentState.getState() == RENT) {
+                rentState.setPending(!confirmRent(slot));
+            }
+
             // 还车
-            if (RENTSTATE.getState() == RENT) {
+            if (rentState.getState() == RENT) {
 
                 // 车辆状态：还车中
-                RENTSTATE.changeState(RETURN_UNDER_WAY);
+                rentState.changeState(RETURN_UNDER_WAY);
                 Log(TAG_LOOP, "Return underway...");
 
                 bool returnSuccess = false;
-                int returnCount = 0;
 
-                // 反复请求还车直至成功
-                while (!returnSuccess && returnCount++ <= MAX_REQUEST_COUNT) {
+                // 同一还车操作的各次重试使用相同编号（服务器去重 超时后重试不会重复结算）
+                unsigned long requestID = REQUESTIDS.issue(slot);
+
+                // 按重试策略请求还车直至成功
+                HTTPCOM.beginRetry(RETRY_RETURN);
+                while (!returnSuccess && HTTPCOM.retry(RETRY_RETURN)) {
                     // 请求还车
-                    returnSuccess = HTTPCOM.requestReturn(BIKEID, serNum);
+                    returnSuccess = HTTPCOM.requestReturn(BIKEIDS[slot], serNum[slot], requestID);
 
                     if (returnSuccess) {
                         if (HTTPCOM.hasResponse()) {
+                            // 此前超时的请求已被服务器处理 回复为原结果 照常处理
+                            if (HTTPCOM.isDuplicate()) {
+                                Log(TAG_COM_RES, "Duplicate Ack: " + String(requestID));
+                            }
                             // 交互模块：返回信息
                             DISPLAYS.displayComMSG(HTTPCOM.getResponse()); 
                             switch (HTTPCOM.getResponse()) {
@@ -323,13 +611,13 @@ void loop() {
                                 Log(TAG_COM_RES, "Return Success!");
                                     
                                     // 车辆状态：未借车
-                                    RENTSTATE.changeState(NOT_RENT);
+                                    rentState.changeState(NOT_RENT);
 
                                     // 交互模块：用户信息
                                     Log(TAG_COM_RES, HTTPCOM.getResponse_UserID());
                                     Log(TAG_COM_RES, HTTPCOM.getResponse_Balance());
                                     Log(TAG_COM_RES, HTTPCOM.getResponse_Duration());
-                                    DISPLAYS.displayDetails(HTTPCOM.getResponse(), HTTPCOM.getResponse_UserID().c_str(), HTTPCOM.getResponse_Balance().c_str(), HTTPCOM.getResponse_Duration().c_str());
+                                    DISPLAYS.displayDetails(HTTPCOM.getResponse(), HTTPCOM.getResponse_UserID(), HTTPCOM.getResponse_Balance(), HTTPCOM.getResponse_Duration());
                                 break;
 
                                 case RETURN_FAIL_USER_NOT_MATCH:        // 还车失败：用户信息冲突
@@ -339,7 +627,7 @@ void loop() {
                                 // 待查
 
                                     // 车辆状态：不可用
-                                    RENTSTATE.changeState(NOT_AVAILABLE);
+                                    rentState.changeState(NOT_AVAILABLE);
                                 break;
 
                                 default:
@@ -367,14 +655,14 @@ void loop() {
                 }
 
                 // 多次尝试失败 车辆不可用
-                if (!returnSuccess && returnCount > MAX_REQUEST_COUNT) {
+                if (!returnSuccess) {
                     Error(TAG_COM + ": hasResponse FALSE");
 
                     // 车辆状态：不可用
-                    RENTSTATE.changeState(NOT_AVAILABLE);
+                    rentState.changeState(NOT_AVAILABLE);
                 }
             } else {
-                Error(TAG_RENTSTATE + ": " + (int) RENTSTATE.getState());
+                Error(TAG_RENTSTATE + ": " + (int) rentState.getState());
                 // 待查
             }
         break;
@@ -384,6 +672,9 @@ void loop() {
         Log(TAG_CARD_MSG, "SAME_CARD_AGAIN");
 
             LOCATION.resumeUpdate();
+
+            // 无需借还车 释放预先打开的承载
+            HTTPCOM.cancelPrepare();
         break;
 
         case CARD_READ_STOP:
@@ -392,6 +683,9 @@ void loop() {
 
             LOCATION.resumeUpdate();
 
+            // 释放预先打开的承载
+            HTTPCOM.cancelPrepare();
+
             // 交互模块：读取中断
             DISPLAYS.displayCardMSG(CARD_READ_STOP);
         break;
@@ -415,8 +709,103 @@ void loop() {
         Error(TAG_CARD_MSG);
         break;
     }
-    
-    // 循环终止操作
-    loopTerm();
 }
 
+
+/**
+ * 阻塞等待期间为其余槽位寻卡（定时器等待钩子 不阻塞）
+ * 按各槽位寻卡间隔寻卡 读卡消息入队 队列满时暂停该槽位寻卡（防抖状态保持）
+ */
+void pollOtherReaders() {
+    for (int slot = 0; slot < STATION_SLOT_COUNT; slot++) {
+        if (slot == servingSlot || cardQueueCount[slot] >= CARD_QUEUE_SIZE) {
+            continue;
+        }
+        if (withinInterval(lastQueuedSearch[slot], sysTime(), CARDS[slot].getPollInterval())) {
+            continue;
+        }
+        lastQueuedSearch[slot] = sysTime();
+
+        CARD_MSG msg = CARDS[slot].searchCard(RENTSTATES[slot].getState());
+        if (msg != NOTHING) {
+            cardQueue[slot][cardQueueCount[slot]].msg = msg;
+            cardQueue[slot][cardQueueCount[slot]].serial = CARDS[slot].getSerNum();
+            cardQueueCount[slot]++;
+        }
+    }
+}
+
+/**
+ * 确认本地授权或乐观开锁的借车（向服务器补发借车请求）
+ * 被服务器拒绝时：显示错误 报告服务器 车辆状态改为不可用（待定位回复恢复）
+ * @param  slot 槽位编号
+ * @return true - 已确认（成功或被服务器拒绝）; false - 未连接服务器 稍后重试
+ */
+bool confirmRent(const int slot) {
+    RentState &rentState = RENTSTATES[slot];
+
+    // 网络注册完成前稍后重试
+    if (!BOOT.isDone(BOOT_NETWORK)) {
+        return false;
+    }
+
+    // 沿用借还状态中保存的请求编号（无记录时分配新编号并保存）
+    if (rentState.getRequestID() == 0) {
+        rentState.changeState(RENT, serNum[slot], true, REQUESTIDS.issue(slot));
+    }
+    if (!HTTPCOM.requestRent(BIKEIDS[slot], serNum[slot], rentState.getRequestID())) {
+        Log(TAG_COM_RES, "Rent Confirm Fail! Backend Not Reached");
+        Log(HTTPCOM.getError());
+        return false;
+    }
+
+    if (!HTTPCOM.hasResponse()) {
+        Error(TAG_COM + ": hasResponse FALSE");
+        return false;
+    }
+
+    // 此前补发已被服务器处理 回复为原结果 照常处理
+    if (HTTPCOM.isDuplicate()) {
+        Log(TAG_COM_RES, "Duplicate Ack");
+    }
+
+    switch (HTTPCOM.getResponse()) {
+        case RENT_SUCCESS:
+        // 借车成功
+        Log(TAG_COM_RES, "Rent Confirmed!");
+        CARDHISTORY.recordSuccess(serNum[slot]);
+
+            // 交互模块：用户信息
+            DISPLAYS.displayDetails(HTTPCOM.getResponse(), HTTPCOM.getResponse_UserID(), HTTPCOM.getResponse_Balance());
+        break;
+
+        case RENT_FAIL_BIKE_OCCUPIED:
+        // 本车已被同一卡片借出：此前的借车请求已被服务器处理（服务器未去重时）
+        if (HTTPCOM.getResponse_CardSerial() == serNum[slot]) {
+            Log(TAG_COM_RES, "Rent Already Recorded!");
+            CARDHISTORY.recordSuccess(serNum[slot]);
+            break;
+        }
+        // 其他卡片占用：按拒绝处理
+        [[fallthrough]];
+
+        default:
+        // 服务器拒绝：车辆已开锁
+        Error(TAG_COM_RES + ": Rent Rejected " + (int) HTTPCOM.getResponse());
+        CARDHISTORY.recordFail(serNum[slot]);
+
+            // 交互模块：拒绝原因
+            DISPLAYS.displayComMSG(HTTPCOM.getResponse());
+
+            // 报告服务器（失败时由下次定位信息反映车辆状态）
+            if (!HTTPCOM.requestRejectReport(BIKEIDS[slot], serNum[slot])) {
+                Error(TAG_COM + ": Reject Report Fail");
+            }
+
+            // 车辆状态：不可用
+            rentState.changeState(NOT_AVAILABLE);
+        break;
+    }
+
+    return true;
+}